@@ -1,4 +1,5 @@
 #include "intelligent/AssemblyConstructor.h"
+#include "intelligent/PotentialTable.h"
 #include "intelligent/AssemblyVisualizer.h"
 #include "intelligent/RendererManager.h"
 #include "intelligent/DiscreteAssembly.h"
@@ -19,44 +20,44 @@
 
 using namespace intelligent;
 
-GibbsVariable::Ptr CreateBlock( const GibbsField& field, unsigned int id ) {
-	return std::make_shared<BlockVariable>( field, id );
+GibbsVariable::Ptr CreateBlock( unsigned int id ) {
+	return std::make_shared<BlockVariable>( id );
 }
 
-GibbsPotential::Ptr CreateSupportPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateSupportPotential( const Lattice& lattice,
 											unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialSupport>( field, id, variableIDs );
+	return std::make_shared<PotentialSupport>( id, variableIDs );
 }
 
-GibbsPotential::Ptr CreateHeightPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateHeightPotential( const Lattice& lattice,
 										   unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialHeight>( field, id, variableIDs, lattice );
+	return std::make_shared<PotentialHeight>( id, variableIDs, lattice );
 }
 
-GibbsPotential::Ptr CreateRepelPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateRepelPotential( const Lattice& lattice,
 										  unsigned int id, const std::vector<unsigned int>& variableIDs, 
 										  const ContinuousPoint3 objPos ) {
-	return std::make_shared<PotentialRepel>( field, id, variableIDs, lattice, objPos );
+	return std::make_shared<PotentialRepel>( id, variableIDs, lattice, objPos );
 }
 
-GibbsPotential::Ptr CreateEdgePotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateEdgePotential( const Lattice& lattice,
 										 unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialEdge>( field, id, variableIDs, lattice );
+	return std::make_shared<PotentialEdge>( id, variableIDs, lattice );
 }
 
-GibbsPotential::Ptr CreateCOMPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateCOMPotential( const Lattice& lattice,
 										unsigned int id, const std::vector<unsigned int>& variableIDs,
 										ContinuousPoint3 com ) {
 	PotentialCOM::Ptr pot =
-		std::make_shared<PotentialCOM>( field, id, variableIDs, lattice );
+		std::make_shared<PotentialCOM>( id, variableIDs, lattice );
 	pot->SetDesiredCOM( com );
 	return pot;
 }
 
-GibbsPotential::Ptr CreateMassPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateMassPotential( const Lattice& lattice,
 										 unsigned int id, const std::vector<unsigned int>& variableIDs,
 										 double massCoeff, double maxMass ) {
-	return std::make_shared<PotentialMass>( field, id, variableIDs, massCoeff, maxMass );
+	return std::make_shared<PotentialMass>( id, variableIDs, massCoeff, maxMass );
 }
 
 void AddCOMPoint( std::vector<DiscretePoint3>& pts, const DiscretePoint3& p ) {
@@ -103,8 +104,10 @@ int main( int argc, char* argv[] ) {
 	// Create the assembly and constructor
 	DiscreteAssembly::Ptr assembly = std::make_shared<DiscreteAssembly>();
 	AssemblyConstructor::VariableConstructor vconst =
-		boost::bind( &CreateBlock, _1, _2 );
+		boost::bind( &CreateBlock, _1 );
 	AssemblyConstructor aconst( vconst );
+	aconst.SetTableLimit( PotentialTable::DefaultMaxEntries );
+	aconst.SetUnaryFusion( true );
 
 	// Add the support potential slot
 	// Order for support slot is top, bottom, 4 sides (in no particular order)
@@ -117,7 +120,7 @@ int main( int argc, char* argv[] ) {
 	supportPoints[5] = DiscretePoint3( 0, 1, 0 );
 	supportPoints[6] = DiscretePoint3( 0, -1, 0 );
 	AssemblySlot::PotentialConstructor supportConstructor =
-		boost::bind( &CreateSupportPotential, _1, _2, _3, _4 );
+		boost::bind( &CreateSupportPotential, _1, _2, _3 );
 	AssemblySlot::Ptr supportSlot =
 		std::make_shared<AssemblySlot>( supportPoints, supportConstructor );
 
@@ -128,7 +131,7 @@ int main( int argc, char* argv[] ) {
 	std::vector<DiscretePoint3> heightPoints;
 	heightPoints.emplace_back( 0, 0, 0 );
 	AssemblySlot::PotentialConstructor heightConstructor =
-		boost::bind( &CreateHeightPotential, _1, _2, _3, _4 );
+		boost::bind( &CreateHeightPotential, _1, _2, _3 );
 	AssemblySlot::Ptr heightSlot =
 		std::make_shared<AssemblySlot>( heightPoints, heightConstructor );
 
@@ -140,7 +143,7 @@ int main( int argc, char* argv[] ) {
 	std::vector<DiscretePoint3> repelPoints;
 	repelPoints.emplace_back( 0, 0, 0 );
 	AssemblySlot::PotentialConstructor repelConstructor =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot =
 		std::make_shared<AssemblySlot>( repelPoints, repelConstructor );
 
@@ -148,7 +151,7 @@ int main( int argc, char* argv[] ) {
 
 	objPos.x = 16;
 	AssemblySlot::PotentialConstructor repelConstructor2 =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot2 =
 		std::make_shared<AssemblySlot>( repelPoints, repelConstructor2 );
 
@@ -156,7 +159,7 @@ int main( int argc, char* argv[] ) {
 
 	objPos.y = 16;
 	AssemblySlot::PotentialConstructor repelConstructor3 =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot3 =
 		std::make_shared<AssemblySlot>( repelPoints, repelConstructor3 );
 
@@ -164,7 +167,7 @@ int main( int argc, char* argv[] ) {
 
 	objPos.x = 4;
 	AssemblySlot::PotentialConstructor repelConstructor4 =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot4 =
 		std::make_shared<AssemblySlot>( repelPoints, repelConstructor4 );
 
@@ -174,7 +177,7 @@ int main( int argc, char* argv[] ) {
 	objPos.y = 10;
 	objPos.z = 10;
 	AssemblySlot::PotentialConstructor repelConstructor5 =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot5 =
 	std::make_shared<AssemblySlot>( repelPoints, repelConstructor5 );
 	
@@ -213,6 +216,9 @@ int main( int argc, char* argv[] ) {
 
 	std::cout << "Created " << assembly->GetField().NumPotentials() << " potentials." << std::endl;
 
+	// Successors inherit tracking, so the log energy below is available in constant time
+	assembly->GetField().SetLogPotentialTracking( true );
+
 	// Visualize the assembly
 	RendererManager rman( "Output", 600, 600 );
 	AssemblyVisualizer aviz( rman );
@@ -274,7 +280,7 @@ int main( int argc, char* argv[] ) {
 
 		SearchProperties properties = tsearch.ComputeProperties( *best );
 		double cost = tsearch.ComputeCost( properties );
-		double logPot = best->GetField().CalculateLogPotential();
+		double logPot = best->GetField().GetLogPotential();
 		
 		if( enableLogging ) {
  			log << sampleCounter << " " << cost << " " << logPot << " " << properties.totalBlocks << std::endl;
@@ -1,4 +1,5 @@
 #include "intelligent/AssemblyConstructor.h"
+#include "intelligent/PotentialTable.h"
 #include "intelligent/AssemblyVisualizer.h"
 #include "intelligent/RendererManager.h"
 #include "intelligent/DiscreteAssembly.h"
@@ -17,48 +18,44 @@
 
 using namespace intelligent;
 
-GibbsVariable::Ptr CreateBlock( const GibbsField& field, unsigned int id ) {
-	return std::make_shared<BlockVariable>( field, id );
+GibbsVariable::Ptr CreateBlock( unsigned int id ) {
+	return std::make_shared<BlockVariable>( id );
 }
 
-GibbsPotential::Ptr CreateSupportPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateSupportPotential( const Lattice& lattice,
 											unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialSupport>( field, id, variableIDs );
+	return std::make_shared<PotentialSupport>( id, variableIDs );
 }
 
-GibbsPotential::Ptr CreateHeightPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateHeightPotential( const Lattice& lattice,
 										   unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialHeight>( field, id, variableIDs, lattice );
+	return std::make_shared<PotentialHeight>( id, variableIDs, lattice );
 }
 
-GibbsPotential::Ptr CreateRepelPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateRepelPotential( const Lattice& lattice,
 										  unsigned int id, const std::vector<unsigned int>& variableIDs, 
 										  const ContinuousPoint3 objPos ) {
-	return std::make_shared<PotentialRepel>( field, id, variableIDs, lattice, objPos );
+	return std::make_shared<PotentialRepel>( id, variableIDs, lattice, objPos );
 }
 
-GibbsPotential::Ptr CreateEdgePotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateEdgePotential( const Lattice& lattice,
 										 unsigned int id, const std::vector<unsigned int>& variableIDs ) {
-	return std::make_shared<PotentialEdge>( field, id, variableIDs, lattice );
+	return std::make_shared<PotentialEdge>( id, variableIDs, lattice );
 }
 
-GibbsPotential::Ptr CreateCOMPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateCOMPotential( const Lattice& lattice,
 										unsigned int id, const std::vector<unsigned int>& variableIDs,
 										ContinuousPoint3 com ) {
 	PotentialCOM::Ptr pot =
-		std::make_shared<PotentialCOM>( field, id, variableIDs, lattice );
+		std::make_shared<PotentialCOM>( id, variableIDs, lattice );
 	pot->SetDesiredCOM( com );
 	return pot;
 }
 
-GibbsPotential::Ptr CreateMassPotential( const GibbsField& field, const Lattice& lattice,
+GibbsPotential::Ptr CreateMassPotential( const Lattice& lattice,
 										 unsigned int id, const std::vector<unsigned int>& variableIDs,
 										 double massCoeff, double maxMass ) {
-	return std::make_shared<PotentialMass>( field, id, variableIDs, massCoeff, maxMass );
-}
-
-void AddCOMPoint( std::vector<DiscretePoint3>& pts, const DiscretePoint3& p ) {
-	pts.push_back(p);
+	return std::make_shared<PotentialMass>( id, variableIDs, massCoeff, maxMass );
 }
 
 void AddInteriorPoint( std::vector<unsigned int>& inds, const Lattice& lattice,
@@ -77,8 +74,10 @@ int main() {
 	// Create the assembly and constructor
 	DiscreteAssembly::Ptr assembly = std::make_shared<DiscreteAssembly>();
 	AssemblyConstructor::VariableConstructor vconst =
-		boost::bind( &CreateBlock, _1, _2 );
+		boost::bind( &CreateBlock, _1 );
 	AssemblyConstructor aconst( vconst );
+	aconst.SetTableLimit( PotentialTable::DefaultMaxEntries );
+	aconst.SetUnaryFusion( true );
 
 	// Add the support potential slot
 	// Order for support slot is top, bottom, 4 sides (in no particular order)
@@ -91,7 +90,7 @@ int main() {
 	supportPoints[5] = DiscretePoint3( 0, 1, 0 );
 	supportPoints[6] = DiscretePoint3( 0, -1, 0 );
 	AssemblySlot::PotentialConstructor supportConstructor =
-		boost::bind( &CreateSupportPotential, _1, _2, _3, _4 );
+		boost::bind( &CreateSupportPotential, _1, _2, _3 );
 	AssemblySlot::Ptr supportSlot =
 		std::make_shared<AssemblySlot>( supportPoints, supportConstructor );
 
@@ -102,7 +101,7 @@ int main() {
 	std::vector<DiscretePoint3> heightPoints;
 	heightPoints.emplace_back( 0, 0, 0 );
 	AssemblySlot::PotentialConstructor heightConstructor =
-		boost::bind( &CreateHeightPotential, _1, _2, _3, _4 );
+		boost::bind( &CreateHeightPotential, _1, _2, _3 );
 	AssemblySlot::Ptr heightSlot =
 		std::make_shared<AssemblySlot>( heightPoints, heightConstructor );
 
@@ -113,7 +112,7 @@ int main() {
 	std::vector<DiscretePoint3> edgePoints;
 	edgePoints.emplace_back( 0, 0, 0 );
 	AssemblySlot::PotentialConstructor edgeConstructor =
-		boost::bind( &CreateEdgePotential, _1, _2, _3, _4 );
+		boost::bind( &CreateEdgePotential, _1, _2, _3 );
 	AssemblySlot::Ptr edgeSlot =
 		std::make_shared<AssemblySlot>( edgePoints, edgeConstructor );
 
@@ -126,7 +125,7 @@ int main() {
 	std::vector<DiscretePoint3> repelPoints;
 	repelPoints.emplace_back( 0, 0, 0 );
 	AssemblySlot::PotentialConstructor repelConstructor =
-		boost::bind( &CreateRepelPotential, _1, _2, _3, _4, objPos);
+		boost::bind( &CreateRepelPotential, _1, _2, _3, objPos);
 	AssemblySlot::Ptr repelSlot =
 		std::make_shared<AssemblySlot>( repelPoints, repelConstructor );
 
@@ -150,28 +149,18 @@ int main() {
 	
 	DiscreteBox3 box( corners );
 	
-	// Get global IDs for global potentials
-	std::vector<DiscretePoint3> allPoints;
-	DiscreteBox3::Operator pushOp =
-		boost::bind( &AddCOMPoint, boost::ref(allPoints), _1 );
-	box.Iterate( pushOp );
-
 	// Make the global COM potential
 	ContinuousPoint3 desiredCOM( 1, 1, 2 );
 	AssemblySlot::PotentialConstructor comConstructor =
-		boost::bind( &CreateCOMPotential, _1, _2, _3, _4, desiredCOM );
-	AssemblySlot::Ptr comSlot =
-		std::make_shared<AssemblySlot>( allPoints, comConstructor );
+		boost::bind( &CreateCOMPotential, _1, _2, _3, desiredCOM );
 
-// 	aconst.AddSlot( comSlot );
+// 	aconst.AddGlobalSlot( comConstructor );
 
 	// Make the global mass potential
 	AssemblySlot::PotentialConstructor massConstructor =
-		boost::bind( &CreateMassPotential, _1, _2, _3, _4, -0.1, 25.0 );
-	AssemblySlot::Ptr massSlot =
-		std::make_shared<AssemblySlot>( allPoints, massConstructor );
+		boost::bind( &CreateMassPotential, _1, _2, _3, -0.1, 25.0 );
 
-//	aconst.AddSlot( massSlot );
+//	aconst.AddGlobalSlot( massConstructor );
 	
 	DiscreteBox3::Operator addOp =
 		boost::bind( &AssemblyConstructor::AddVoxel, &aconst,
@@ -183,17 +172,15 @@ int main() {
 
 	// Add a fix potential for the seed block manually
 	unsigned int seedID = assembly->GetLattice().GetNodeID( DiscretePoint3( 1, 1, 0 ) );
-	GibbsVariable::Ptr seedVar = assembly->GetField().GetVariable( seedID );
 	std::vector<unsigned int> seedClique;
 	seedClique.push_back( seedID );
 	PotentialFixed::Ptr fixPot =
-		std::make_shared<PotentialFixed>( assembly->GetField(),
-										  assembly->GetField().NumPotentials(),
+		std::make_shared<PotentialFixed>( assembly->GetField().NumPotentials(),
 										  seedClique, BLOCK_FULL );
 	
-	seedVar->AddPotential( fixPot->id );
 	assembly->GetField().AddPotential( fixPot );
-	std::dynamic_pointer_cast<BlockVariable>( seedVar )->SetState( BLOCK_FULL );
+	assembly->GetField().BuildAdjacency();
+	assembly->SetBlockState( seedID, BLOCK_FULL );
 	
 	std::cout << "Created " << assembly->GetField().NumPotentials() << " potentials." << std::endl;
 
@@ -211,6 +198,7 @@ int main() {
 	MCMCSampler mcmcSampler;
 	mcmcSampler.SetIndexSet( interiorIDs );
 	AssemblySampler aSampler( mcmcSampler );
+	aSampler.SetThreadPool( std::make_shared<ThreadPool>() );
 	TreeSearch tSearch( aSampler );
 	tSearch.Add( assembly );
 	
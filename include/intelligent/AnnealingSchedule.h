@@ -0,0 +1,86 @@
+#ifndef _ANNEALING_SCHEDULE_H_
+#define _ANNEALING_SCHEDULE_H_
+
+#include <memory>
+
+namespace intelligent {
+
+	/*! \brief Chooses the inverse temperature of each MCMCSampler sweep for
+	 * simulated annealing. Schedules are stateless, so one may be shared by any
+	 * number of samplers and threads. */
+	class AnnealingSchedule {
+	public:
+
+		typedef std::shared_ptr<const AnnealingSchedule> Ptr;
+
+		virtual ~AnnealingSchedule() {}
+
+		/*! \brief Returns the inverse temperature for the specified sweep, counted
+		 * from 0. For later sweeps, lastBeta is the previous sweep's inverse
+		 * temperature and changeRate the fraction of its updates that changed a
+		 * variable's state. */
+		virtual double GetInverseTemperature( unsigned int sweep, double lastBeta,
+											  double changeRate ) const = 0;
+
+	};
+
+	/*! \brief Multiplies the inverse temperature by a fixed ratio every sweep. */
+	class GeometricSchedule : public AnnealingSchedule {
+	public:
+
+		GeometricSchedule( double _initialBeta, double _ratio, double _maxBeta );
+
+		virtual double GetInverseTemperature( unsigned int sweep, double lastBeta,
+											  double changeRate ) const;
+
+	private:
+
+		double initialBeta;
+		double ratio;
+		double maxBeta;
+
+	};
+
+	/*! \brief Moves the inverse temperature linearly from an initial to a final
+	 * value over a number of sweeps, and holds it there afterwards. */
+	class LinearSchedule : public AnnealingSchedule {
+	public:
+
+		LinearSchedule( double _initialBeta, double _finalBeta, unsigned int _numSweeps );
+
+		virtual double GetInverseTemperature( unsigned int sweep, double lastBeta,
+											  double changeRate ) const;
+
+	private:
+
+		double initialBeta;
+		double finalBeta;
+		unsigned int numSweeps;
+
+	};
+
+	/*! \brief Steers the fraction of updates that change a state towards a
+	 * target. Each sweep scales the inverse temperature by
+	 * exp( gain*(changeRate - targetRate) ), cooling while the field is still
+	 * changing more often than the target and reheating when it has frozen. */
+	class AdaptiveSchedule : public AnnealingSchedule {
+	public:
+
+		AdaptiveSchedule( double _initialBeta, double _targetRate, double _gain,
+						  double _maxBeta );
+
+		virtual double GetInverseTemperature( unsigned int sweep, double lastBeta,
+											  double changeRate ) const;
+
+	private:
+
+		double initialBeta;
+		double targetRate;
+		double gain;
+		double maxBeta;
+
+	};
+
+}
+
+#endif
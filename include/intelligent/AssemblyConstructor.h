@@ -3,6 +3,7 @@
 
 #include "intelligent/Lattice.h"
 #include "intelligent/DiscreteAssembly.h"
+#include "intelligent/ThreadPool.h"
 
 namespace intelligent {
 
@@ -17,7 +18,7 @@ namespace intelligent {
 
 		typedef std::shared_ptr<AssemblySlot> Ptr;
 		typedef boost::function <GibbsPotential::Ptr
-			( const GibbsField&, const Lattice&, unsigned int, const std::vector<unsigned int>& )>
+			( const Lattice&, unsigned int, const std::vector<unsigned int>& )>
 			PotentialConstructor;
 
 		AssemblySlot( const std::vector <DiscretePoint3>& _points,
@@ -28,6 +29,30 @@ namespace intelligent {
 		void UpdateSlot( DiscreteAssembly& assembly,
 						 const DiscretePoint3& added );
 
+		/*! \brief Constructs this slot's potential centered at the query position
+		 * with the specified ID without adding it to the field. Returns null if
+		 * any of the slot's nodes do not exist. */
+		GibbsPotential::Ptr CreatePotential( DiscreteAssembly& assembly,
+											 const DiscretePoint3& query,
+											 unsigned int potID ) const;
+
+		/*! \brief Finds the IDs of this slot's nodes centered at the query
+		 * position, in slot order. Returns false if any of them do not exist. */
+		bool MatchNodes( const Lattice& lattice, const DiscretePoint3& query,
+						 std::vector<unsigned int>& ids ) const;
+
+		/*! \brief Runs this slot's potential constructor on matched node IDs. */
+		GibbsPotential::Ptr ConstructPotential( const Lattice& lattice, unsigned int potID,
+												const std::vector<unsigned int>& ids ) const;
+
+		/*! \brief Returns the box of query positions inside the specified lattice
+		 * bounds at which this slot's nodes also all fall inside them. Empty if
+		 * there are none. */
+		DiscreteBox3 GetAnchorRange( const DiscreteBox3& latticeBox ) const;
+
+		/*! \brief Returns whether this slot spans a single node. */
+		bool IsUnary() const;
+
 	private:
 
 		DiscreteBox3 boundingBox;
@@ -45,24 +70,98 @@ namespace intelligent {
 	class AssemblyConstructor {
 	public:
 
-		typedef boost::function<GibbsVariable::Ptr( const GibbsField&, unsigned int )>
+		typedef boost::function<GibbsVariable::Ptr( unsigned int )>
 				VariableConstructor;
+
+		/*! \brief The order in which AddVoxels() and BuildPotentials() visit
+		 * positions, and so assign variable and potential IDs. */
+		enum VoxelOrdering {
+			ORDER_LEXICOGRAPHIC = 0, // DiscreteBox3::Iterate() order
+			ORDER_MORTON // DiscreteBox3::IterateMorton() order
+		};
 		
 		AssemblyConstructor( VariableConstructor constructor );
 		
 		/*! \brief Adds a new slot checking object to this constructor. */
 		void AddSlot( const AssemblySlot::Ptr& slot );
 
+		/*! \brief Adds a global slot, whose potential spans every variable in the
+		 * assembly. BuildPotentials() instantiates it once with all variable IDs
+		 * in increasing order, which takes time linear in the number of variables
+		 * where an ordinary slot spanning the whole box would take quadratic. The
+		 * constructor is copied, and may return null to add nothing. */
+		void AddGlobalSlot( const AssemblySlot::PotentialConstructor& constructor );
+
 		/*! \brief Adds the specified voxel to the assembly. */
 		void AddVoxel( DiscreteAssembly& assembly, const DiscretePoint3& pos );
 
-		/*! \brief Check all slots over all positions. */
+		/*! \brief Adds every voxel in the box to the assembly in the current
+		 * voxel ordering. */
+		void AddVoxels( DiscreteAssembly& assembly, const DiscreteBox3& box );
+
+		/*! \brief Sets the voxel ordering. Under ORDER_MORTON, lattice neighbours
+		 * mostly receive nearby variable and potential IDs, so a potential's
+		 * clique and a variable's potentials share cache lines during sampling.
+		 * Defaults to ORDER_LEXICOGRAPHIC. */
+		void SetVoxelOrdering( VoxelOrdering ordering );
+
+		/*! \brief Check all slots over all positions, then instantiate global
+		 * slots, then build the field's adjacency tables. */
 		void BuildPotentials( DiscreteAssembly& assembly );
+
+		/*! \brief Sets the pool that BuildPotentials() matches and constructs slot
+		 * potentials on. Potential IDs are assigned in voxel order regardless, so
+		 * the field built is identical to one built without a pool. Slot
+		 * constructors must then be safe to call from several threads at once. */
+		void SetThreadPool( const ThreadPool::Ptr& _pool );
+
+		/*! \brief Sets the largest joint state space, in entries, of potentials
+		 * that BuildPotentials() replaces with lookup tables. 0 disables
+		 * tabulation, which is the default. */
+		void SetTableLimit( std::size_t maxEntries );
+
+		/*! \brief Sets whether BuildPotentials() collapses all potentials from
+		 * unary slots on a voxel into a single tabulated factor. The individual
+		 * potentials are evaluated once and never added to the field, so stacking
+		 * more unary slots costs nothing at sampling time. Disabled by default. */
+		void SetUnaryFusion( bool enable );
 		
 	private:
 
 		VariableConstructor constructor;
 		std::vector<AssemblySlot::Ptr> slots;
+		std::vector<AssemblySlot::PotentialConstructor> globalSlots;
+		std::size_t tableLimit;
+		bool fuseUnary;
+		VoxelOrdering ordering;
+		ThreadPool::Ptr pool;
+
+		/*! \brief Each thread gets several bricks of anchors to balance load. */
+		static const unsigned int BricksPerThread = 8;
+
+		/*! \brief Runs the operator over the box in the current voxel ordering. */
+		void Iterate( const DiscreteBox3& box, const DiscreteBox3::Operator& op ) const;
+
+		/*! \brief Returns the positions at which the slot can fit in the lattice,
+		 * in the current voxel ordering. */
+		std::vector<DiscretePoint3> ListAnchors( const AssemblySlot& slot,
+												 const Lattice& lattice ) const;
+
+		/*! \brief The number of bricks to split a list of anchors into. Brick b
+		 * holds anchors [b*numAnchors/numBricks, (b+1)*numAnchors/numBricks). */
+		unsigned int NumBricks( std::size_t numAnchors ) const;
+
+		/*! \brief Calls task(b) for every brick, on the pool if there is one. */
+		void RunBricks( unsigned int numBricks, const ThreadPool::Task& task ) const;
+
+		/*! \brief Adds the slot's potentials at every anchor in voxel order, with
+		 * matching and construction spread over the pool. */
+		void BuildSlotPotentials( DiscreteAssembly& assembly, const AssemblySlot& slot );
+
+		/*! \brief Adds one tabulated potential per voxel holding the summed log
+		 * values of all unary slots there. */
+		void BuildFusedUnaryPotentials( DiscreteAssembly& assembly,
+										const std::vector<AssemblySlot::Ptr>& unarySlots );
 		
 	};
 
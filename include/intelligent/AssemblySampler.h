@@ -21,10 +21,29 @@ namespace intelligent {
 		std::vector<DiscreteAssembly::Ptr> Sample( unsigned int numSamples,
 												   unsigned int sampleDepth );
 
+		/*! \brief Sets whether Sample() interprets sampleDepth as a number of
+		 * MCMCSampler::Sweep() sweeps rather than single-variable updates. */
+		void SetDepthInSweeps( bool enable );
+
+		/*! \brief Sets a pool on which Sample() runs its chains concurrently.
+		 * Without a pool, chains run in turn on the calling thread. */
+		void SetThreadPool( const ThreadPool::Ptr& _pool );
+
+		/*! \brief Seeds the sampler. Each chain runs on its own fork of the
+		 * sampler, so the samples drawn after seeding are the same with or
+		 * without a thread pool. */
+		void SetSeed( uint64_t seed );
+
 	protected:
 
 		MCMCSampler& sampler;
 		DiscreteAssembly::Ptr baseAssembly;
+		bool depthInSweeps;
+		ThreadPool::Ptr pool;
+
+		/*! \brief Runs one chain on the sample with the specified sampler. */
+		void RunChain( MCMCSampler& chainSampler, DiscreteAssembly& sample,
+					   unsigned int sampleDepth ) const;
 		
 	};
 	
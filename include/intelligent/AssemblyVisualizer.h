@@ -25,9 +25,8 @@ namespace intelligent {
 
 		bool showOutlines;
 
-		void VisualizePoint( const DiscreteAssembly& assembly,
-							 std::vector<RenderRequestVariant>& requests,
-							 const DiscretePoint3& point );
+		void VisualizeBlock( std::vector<RenderRequestVariant>& requests,
+							 const DiscretePoint3& point, BlockType state );
 		
 	};
 	
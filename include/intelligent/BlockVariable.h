@@ -16,25 +16,38 @@ namespace intelligent {
 		
 			typedef std::shared_ptr<BlockVariable> Ptr;
 
-			virtual GibbsVariable::Ptr Clone( const GibbsField& _field );
+			virtual unsigned int NumStates() const;
 
-			virtual void Sample( double rng );
+			virtual unsigned char SampleState( const GibbsField& field, double rng ) const;
 
-			BlockVariable( const GibbsField& _field, unsigned int id );
-			
-			BlockVariable( const GibbsField& _field, const BlockVariable& other );	
+			BlockVariable( unsigned int id );
 
 			// HACK For debugging!
-			void SetState( BlockType _state );
-			BlockType GetState() const;
-			
-
-	private:
-		
-			BlockType state;
+			void SetState( GibbsField& field, BlockType _state ) const;
+			BlockType GetState( const GibbsField& field ) const;
 
 	};
 
+	/*! \brief The mass of a block in the specified state. */
+	inline double GetBlockMass( BlockType type ) {
+		switch( type ) {
+			case BLOCK_FULL: return 1.0;
+			case BLOCK_HALF: return 0.5;
+			default: return 0.0;
+		}
+	}
+
+	/*! \brief Retrieve the state of a block variable in a field. For use in
+	 * potential evaluation. */
+	inline BlockType GetBlockState( const GibbsField& field, unsigned int id ) {
+		return static_cast<BlockType>( field.GetState( id ) );
+	}
+
+	/*! \brief Retrieve the state of the i-th block variable in a clique view. */
+	inline BlockType GetBlockState( const CliqueStates& states, std::size_t i ) {
+		return static_cast<BlockType>( states[i] );
+	}
+
 }
 
-#endif
\ No newline at end of file
+#endif
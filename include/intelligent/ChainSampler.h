@@ -0,0 +1,75 @@
+#ifndef _CHAIN_SAMPLER_H_
+#define _CHAIN_SAMPLER_H_
+
+#include "intelligent/GibbsField.h"
+
+namespace intelligent {
+
+	/*! \brief Draws a chain of variables jointly from their conditional given the
+	 * rest of a field, by forward filtering and backward sampling. The potentials
+	 * touching the chain may couple chain variables at most MaxOrder positions
+	 * apart, so that the dynamic program runs over tuples of at most MaxOrder
+	 * states. A vertical column of blocks under the support potential, whose
+	 * cliques span three consecutive heights, has order 2. */
+	class ChainSampler {
+	public:
+
+		static const unsigned int MaxOrder = 3;
+
+		/*! \brief Working memory for Draw(), one per concurrent caller. */
+		struct Workspace {
+			std::vector<double> logFactors;
+			std::vector<double> logMessages;
+			std::vector<unsigned char> cliqueStates;
+		};
+
+		/*! \brief Analyzes the potentials touching the chain in the field, which
+		 * must have its adjacency built. Throws if a potential couples chain
+		 * variables more than MaxOrder positions apart. */
+		ChainSampler( const GibbsField& field, const std::vector<unsigned int>& _chain );
+
+		/*! \brief The number of variables in the chain. */
+		std::size_t size() const { return chain.size(); }
+
+		/*! \brief The largest distance between chain positions that share a potential. */
+		unsigned int GetOrder() const;
+
+		const std::vector<unsigned int>& GetChain() const;
+
+		/*! \brief Draws the states of the chain from its joint conditional raised
+		 * to the inverse temperature beta, writing them into out in chain order.
+		 * uniforms supplies size()+1 random numbers in [0,1). Does not modify the
+		 * field, so chains that share no potential may be drawn concurrently. */
+		void Draw( const GibbsField& field, double beta, const double* uniforms,
+				   unsigned char* out, Workspace& workspace ) const;
+
+	private:
+
+		std::vector<unsigned int> chain;
+		std::vector<unsigned int> radices;
+		unsigned int order;
+		unsigned int maxRadix;
+
+		/*! \brief The potentials assigned to each chain position, which is the
+		 * last position each touches, in CSR form. */
+		std::vector<unsigned int> factorOffsets;
+		std::vector<unsigned int> factorPotentials;
+
+		/*! \brief For each clique member of each assigned potential, how many
+		 * positions before the assigned one its variable is, or -1 if it is not in
+		 * the chain. In CSR form over the assigned potentials. */
+		std::vector<unsigned int> memberOffsets;
+		std::vector<int> memberLags;
+
+		/*! \brief The number of states at a chain position. Positions before the
+		 * chain start have a single state, which lets the first few tuples of the
+		 * dynamic program reach before the start. */
+		unsigned int GetRadix( int position ) const {
+			return position < 0 ? 1 : radices[position];
+		}
+
+	};
+
+}
+
+#endif
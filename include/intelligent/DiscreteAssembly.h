@@ -9,6 +9,8 @@
 
 namespace intelligent {
 
+	/*! \brief A Gibbs field of blocks arranged on a lattice. Copies share the
+	 * field topology and lattice, and only duplicate the block states. */
 	class DiscreteAssembly {
 	public:
 
@@ -22,15 +24,20 @@ namespace intelligent {
 		GibbsField& GetField();
 		const GibbsField& GetField() const;
 
+		/*! \brief Mutable lattice access. Detaches this assembly from any lattice
+		 * it shares with its copies. */
 		Lattice& GetLattice();
 		const Lattice& GetLattice() const;
 
 		BlockVariable::Ptr GetBlock( unsigned int id ) const;
+
+		BlockType GetBlockState( unsigned int id ) const;
+		void SetBlockState( unsigned int id, BlockType state );
 		
 	private:
 
 		GibbsField field;
-		Lattice lattice;
+		std::shared_ptr<Lattice> lattice;
 		
 	};
 	
@@ -73,6 +73,11 @@ namespace intelligent {
 
 		/*! \brief Execute the operator over all points in the box. */
 		void Iterate( Operator op ) const;
+
+		/*! \brief Execute the operator over all points in the box in Morton
+		 * (Z-order) of their offsets from the box minima, with z the lowest bit,
+		 * then y, then x. Points close in this order are close in space. */
+		void IterateMorton( Operator op ) const;
 	};
 	
 }
@@ -1,9 +1,12 @@
 #ifndef _GIBBS_FIELD_H_
 #define _GIBBS_FIELD_H_
 
+#include "intelligent/PackedStateArray.h"
+
 #include <memory>
 #include <vector>
-#include <unordered_map>
+#include <limits>
+#include <cassert>
 
 namespace intelligent {
 
@@ -11,129 +14,491 @@ namespace intelligent {
 	class GibbsVariable;
 
 	/*! \note This Gibbs field implementation uses runtime lookup for speed.
-	 * I expect the fields to be copied a lot, so we trade off sampling speed for copy
-	 * construction complexity. Specifically, variables (nodes) and potentials (edges) do
-	 * not store pointers to each other. All operations requiring this information depend
-	 * on ID-based lookup from the owning field.
+	 * I expect the fields to be copied a lot, so the field is split into two parts.
+	 * The topology (variables, potentials and their parameters) never changes once
+	 * built and is shared between copies behind a single pointer. The state is a
+	 * compact array of per-variable values owned by each field, packed at two bits
+	 * per variable, so copying a field amounts to copying that array. Variables
+	 * and potentials are therefore stateless and receive the field they should
+	 * operate on as an argument. Consequently variables may take at most
+	 * PackedStateArray::MaxStates values.
 	 *
-	 * Note that we assume IDs are assigned sequentially, starting from 0. This means
+	 * Note that we require IDs to be assigned sequentially, starting from 0. This means
 	 * that the largest ID in a field is the number of variables minus one, and the same
-	 * for potentials.
+	 * for potentials. The field exploits this by storing both in ID-indexed arrays.
+	 *
+	 * Once a field is fully constructed, BuildAdjacency() packs the variable-potential
+	 * incidence into compressed sparse row tables so that the sampling loops can walk
+	 * cliques and neighborhoods without allocating. Fields with statistics or log-
+	 * potential tracking need the tables to set states, and never build them on
+	 * demand there, since doing so would unshare the topology mid-sampling.
+	 *
+	 * Potentials do not read the field directly but are evaluated on a CliqueStates
+	 * view. This lets the samplers ask what a potential would be if one variable took
+	 * a candidate value without writing that value into the field.
+	 *
+	 * Potentials over large cliques can instead keep a few running statistics, such
+	 * as a total mass, in the field. These are updated in constant time by SetState()
+	 * and the potential is evaluated from them without visiting its clique.
 	 */
-	
+
+	/*! \brief A non-owning, contiguous range of IDs. Only valid until the owning
+	 * container is modified. */
+	struct IDRange {
+
+		typedef const unsigned int* iterator;
+		typedef const unsigned int* const_iterator;
+
+		const unsigned int* first;
+		const unsigned int* last;
+
+		IDRange() : first( nullptr ), last( nullptr ) {}
+		IDRange( const unsigned int* _first, const unsigned int* _last ) :
+			first( _first ), last( _last ) {}
+
+		const unsigned int* begin() const { return first; }
+		const unsigned int* end() const { return last; }
+		std::size_t size() const { return last - first; }
+		unsigned int operator[]( std::size_t i ) const { return first[i]; }
+	};
+
+	/*! \brief A read-only view of the states of a clique, in clique order. The
+	 * states come either from a field, optionally with one variable replaced by a
+	 * candidate value, or from an array supplied by the caller. Only valid while
+	 * its sources are. */
+	class CliqueStates {
+	public:
+
+		/*! \brief View the states the clique takes in the field. */
+		CliqueStates( const GibbsField& _field, IDRange _ids );
+
+		/*! \brief View the states the clique takes in the field, except that the
+		 * variable candidateID takes candidateState. */
+		CliqueStates( const GibbsField& _field, IDRange _ids,
+					  unsigned int _candidateID, unsigned char _candidateState );
+
+		/*! \brief View states already gathered in clique order. */
+		CliqueStates( IDRange _ids, const unsigned char* _values );
+
+		std::size_t size() const { return ids.size(); }
+
+		/*! \brief The ID of the i-th clique variable. */
+		unsigned int GetID( std::size_t i ) const { return ids[i]; }
+
+		/*! \brief The state of the i-th clique variable. */
+		unsigned char operator[]( std::size_t i ) const;
+
+	private:
+
+		static const unsigned int NoCandidate = std::numeric_limits<unsigned int>::max();
+
+		const GibbsField* field;
+		IDRange ids;
+		const unsigned char* values;
+		unsigned int candidateID;
+		unsigned char candidateState;
+
+	};
+
 	/*! \brief Superclass for all potentials in a Gibbs field. Equivalent to an
-	 * edge in the Gibbs graph. */
+	 * edge in the Gibbs graph. Potentials are immutable once constructed. */
 	class GibbsPotential {
 	public:
-		
-		typedef std::shared_ptr<GibbsPotential> Ptr;
 
-		/*! \brief The field this potential belongs to. */
-		const GibbsField& field;
+		typedef std::shared_ptr<GibbsPotential> Ptr;
 
 		/*! \brief This potential's field-unique ID. */
 		const unsigned int id;
 
 		/*! \brief Construct a new potential with a specified ID and specified variable IDs. */
-		GibbsPotential( const GibbsField& _field, unsigned int _id,
-						const std::vector<unsigned int>& _variableIDs );
+		GibbsPotential( unsigned int _id, const std::vector<unsigned int>& _variableIDs );
 
-		/*! \brief Copy a potential but assign it to a different field. */
-		GibbsPotential( const GibbsField& _field, const GibbsPotential& other );
+		virtual ~GibbsPotential();
 
-		/*! \brief Return a smart pointer to a copy-constructed potential. */
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field ) = 0;
-		
 		/*! \brief Return the exponent potential for this potential for
-		 * the current values of its relevant variables. */
-		virtual double CalculatePotential() = 0;
+		 * the values its relevant variables take in the specified field. */
+		double CalculatePotential( const GibbsField& field ) const;
+
+		/*! \brief Return the potential as if the variable varID, which must be in
+		 * this potential's clique, took the candidate state. Does not modify the field. */
+		double CalculatePotential( const GibbsField& field, unsigned int varID,
+								   unsigned char candidate ) const;
+
+		/*! \brief Write the potential for each of the numStates candidate states of
+		 * variable varID into out. The default gathers the clique from the field once
+		 * and evaluates every candidate on the gathered copy. */
+		virtual void CalculateCandidatePotentials( const GibbsField& field, unsigned int varID,
+												   unsigned int numStates, double* out ) const;
+
+		/*! \brief Evaluate this potential on the specified clique states. This is
+		 * the only evaluation that subclasses must implement. */
+		virtual double Evaluate( const CliqueStates& states ) const = 0;
+
+		/*! \brief Return the natural log of the potential, -infinity for 0, for the
+		 * values its relevant variables take in the specified field. */
+		double CalculateLogPotential( const GibbsField& field ) const;
+
+		/*! \brief Log counterpart of the candidate CalculatePotential(). */
+		double CalculateLogPotential( const GibbsField& field, unsigned int varID,
+									  unsigned char candidate ) const;
+
+		/*! \brief Log counterpart of CalculateCandidatePotentials(). */
+		virtual void CalculateCandidateLogPotentials( const GibbsField& field, unsigned int varID,
+													  unsigned int numStates, double* out ) const;
+
+		/*! \brief Evaluate the log of this potential on the specified clique states.
+		 * The default takes the log of Evaluate(). Subclasses that can produce the
+		 * log directly should override this to avoid the exp/log round trip and
+		 * underflow of very small potentials. */
+		virtual double EvaluateLog( const CliqueStates& states ) const;
+
+		/*! \brief Returns whether the other potential, which has the same dynamic
+		 * type, evaluates identically on any clique states. Used to share lookup
+		 * tables. The default conservatively returns false. */
+		virtual bool IsEquivalent( const GibbsPotential& other ) const;
+
+		/*! \brief The most statistics a potential may keep. */
+		static const unsigned int MaxStatistics = 8;
+
+		/*! \brief The number of running statistics this potential keeps in the
+		 * field. Potentials returning non-zero must implement the statistics
+		 * methods below, and are then evaluated from their statistics whenever
+		 * they are evaluated on a field. The default is 0. */
+		virtual unsigned int NumStatistics() const;
 
-		// NOTE No way around this typedef hack
-		/*! \brief Get the variables that this potential operates over. */
-		std::vector < std::shared_ptr<GibbsVariable> > GetClique() const;
+		/*! \brief Compute the statistics of the specified clique states from scratch. */
+		virtual void InitializeStatistics( const CliqueStates& states, double* stats ) const;
+
+		/*! \brief Update the statistics for the clique variable at cliqueIndex
+		 * changing from oldState to newState. Must take constant time. */
+		virtual void UpdateStatistics( std::size_t cliqueIndex, unsigned char oldState,
+									   unsigned char newState, double* stats ) const;
+
+		/*! \brief Evaluate this potential, or its log, from its statistics. */
+		virtual double EvaluateStatistics( const double* stats ) const;
+		virtual double EvaluateLogStatistics( const double* stats ) const;
+
+		/*! \brief Get the IDs of the variables this potential operates over, in
+		 * clique order. Does not allocate. */
+		IDRange GetCliqueIDs() const;
 
 	private:
 
+		/*! \brief Cliques up to this size are gathered onto the stack when
+		 * evaluating candidates. Larger ones are read through the field. */
+		static const unsigned int MaxGatheredClique = 32;
+
+		/*! \brief Evaluates every candidate of varID with Evaluate(), or with
+		 * EvaluateLog() if useLog is set. */
+		void EvaluateCandidates( const GibbsField& field, unsigned int varID,
+								 unsigned int numStates, bool useLog, double* out ) const;
+
+		/*! \brief Writes into candidateStats the statistics the field keeps for
+		 * this potential as if varID took the candidate state. Requires adjacency. */
+		void ComputeCandidateStatistics( const GibbsField& field, const double* stats,
+										 unsigned int varID, unsigned char candidate,
+										 double* candidateStats ) const;
+
+		/*! \brief Returns this potential's statistics in the field, or null if the
+		 * field does not keep any for it. */
+		const double* FindStatistics( const GibbsField& field ) const;
+
 		/*! \brief The IDs corresponding to this potential's variables. */
 		std::vector<unsigned int> variableIDs;
 
 	};
 
 	/*! \brief Superclass for all variables in a Gibbs field. Equivalent to a
-	 * node in the Gibbs graph. */
+	 * node in the Gibbs graph. Variables hold no state of their own; their values
+	 * live in the owning field. The methods that visit adjacent potentials read the
+	 * field's CSR tables and throw std::logic_error unless it HasAdjacency(). */
 	class GibbsVariable {
 	public:
 
 		typedef std::shared_ptr<GibbsVariable> Ptr;
 
-		/*! \brief The field this variable belongs to. */
-		const GibbsField& field;
-
 		/*! \brief This variable's field-unique ID. */
 		const unsigned int id;
 
 		/*! \brief Construct a new variable with specified ID. */
-		GibbsVariable( const GibbsField& _field, unsigned int _id );
+		GibbsVariable( unsigned int _id );
+
+		virtual ~GibbsVariable();
 
-		/*! \brief Copy a variable but assign it to a different field. */
-		GibbsVariable( const GibbsField& _field, const GibbsVariable& other );
+		/*! \brief The number of values this variable can take. States are
+		 * numbered from 0. */
+		virtual unsigned int NumStates() const = 0;
 
-		/*! \brief Return a smart poitner to a copy-constructed variable. */
-		virtual GibbsVariable::Ptr Clone( const GibbsField& _field ) = 0;
-		
-		/*! \brief Given a random sample in [0,1], sample this variable
-		 * proportional to its potentials. */
-		virtual void Sample( double rng ) = 0;
+		/*! \brief Given a random sample in [0,1], draw a state for this variable
+		 * proportional to its potentials in the specified field. Does not modify
+		 * the field, so variables that share no potential may be drawn concurrently. */
+		virtual unsigned char SampleState( const GibbsField& field, double rng ) const = 0;
+
+		/*! \brief Given a random sample in [0,1], sample this variable in the
+		 * specified field proportional to its potentials. */
+		void Sample( GibbsField& field, double rng ) const;
 
 		/*! \brief Calculate the product of potentials connected
-		 * to this variable. */
-		double CalculatePotential();
+		 * to this variable in the specified field. */
+		double CalculatePotential( const GibbsField& field ) const;
 
-		/*! \brief Get the potentials that operate on this variable. */
-		std::vector<GibbsPotential::Ptr> GetPotentials() const;
+		/*! \brief Write the unnormalized conditional probability of each of this
+		 * variable's NumStates() states into out, given the rest of the field.
+		 * Visits each adjacent potential once and does not modify the field. */
+		void CalculateConditionals( const GibbsField& field, double* out ) const;
 
-		/*! \brief Adds an additional potential to this variable. */
-		void AddPotential( unsigned int potID );
-		
-	private:
+		/*! \brief Calculate the sum of log potentials connected to this variable
+		 * in the specified field. */
+		double CalculateLogPotential( const GibbsField& field ) const;
+
+		/*! \brief Log counterpart of CalculateConditionals(). The conditionals are
+		 * unnormalized log probabilities and may be -infinity. */
+		void CalculateLogConditionals( const GibbsField& field, double* out ) const;
 
-		/*! \brief The IDs corresponding to this variable's potentials. */
-		std::vector<unsigned int> potentialIDs;
-		
 	};
-	
+
 	class GibbsField {
 	public:
 
+		/*! \brief Creates an empty field with its own topology. */
 		GibbsField();
-		GibbsField( const GibbsField& other );
 
+		// NOTE Copy construction and assignment share the topology and copy the state.
+
+		/*! \brief Adds a variable with initial state 0. */
 		void AddVariable( const GibbsVariable::Ptr& var );
+
+		/*! \brief Adds a potential. It is automatically registered with the
+		 * variables in its clique. */
 		void AddPotential( const GibbsPotential::Ptr& pot );
 
+		/*! \brief Replaces the potential with the same ID by an implementation over
+		 * the same clique, such as a tabulated one. Adjacency tables stay valid. */
+		void ReplacePotential( const GibbsPotential::Ptr& pot );
+
 		GibbsVariable::Ptr GetVariable( unsigned int id ) const;
 		std::vector<GibbsVariable::Ptr> GetVariables() const;
 		std::size_t NumVariables() const;
-		
+
 		GibbsPotential::Ptr GetPotential( unsigned int id ) const;
 		std::vector<GibbsPotential::Ptr> GetPotentials() const;
 		std::size_t NumPotentials() const;
 
-		double CalculateLogPotential();
-		
+		/*! \brief Non-owning, unchecked access for the sampling loops. Avoids the
+		 * reference count traffic of the smart pointer accessors. */
+		const GibbsVariable* GetVariableRaw( unsigned int id ) const {
+			return topology->variables[id].get();
+		}
+
+		const GibbsPotential* GetPotentialRaw( unsigned int id ) const {
+			return topology->potentials[id].get();
+		}
+
+		/*! \brief Retrieve or set the state of a variable. Setting a variable to
+		 * its current state does nothing. Otherwise setting throws std::logic_error
+		 * if the field keeps statistics or tracks its log-potential and
+		 * HasAdjacency() is false. */
+		unsigned char GetState( unsigned int id ) const {
+			return states.Get( id );
+		}
+
+		void SetState( unsigned int id, unsigned char state ) {
+			if( states.Get( id ) == state ) {
+				return;
+			}
+			if( trackLogPotential ) {
+				AccumulateTrackedPotentials( id, false );
+			}
+			if( !statistics.empty() ) {
+				UpdateStatistics( id, states.Get( id ), state );
+			}
+			states.Set( id, state );
+			if( trackLogPotential ) {
+				AccumulateTrackedPotentials( id, true );
+			}
+		}
+
+		/*! \brief Retrieve the states of all variables, indexed by ID. */
+		const PackedStateArray& GetStates() const;
+
+		/*! \brief Overwrite the states of all variables. The array must have one
+		 * entry per variable. */
+		void SetStates( const PackedStateArray& _states );
+
+		/*! \brief Retrieve the running statistics kept for a potential, or null
+		 * if it keeps none. */
+		const double* GetStatistics( unsigned int potID ) const {
+			const Topology& t = *topology;
+			if( t.statisticOffsets[potID] == t.statisticOffsets[potID+1] ) {
+				return nullptr;
+			}
+			return statistics.data() + t.statisticOffsets[potID];
+		}
+
+		/*! \brief Returns whether this field shares its topology with the other. */
+		bool SharesTopology( const GibbsField& other ) const;
+
+		/*! \brief Sum the log of every potential in the field. */
+		double CalculateLogPotential() const;
+
+		/*! \brief Enables or disables maintaining a running total log-potential.
+		 * While enabled, each SetState() evaluates the potentials adjacent to the
+		 * changed variable before and after the write and applies the difference,
+		 * so the field carries only the total. Enabling computes the total from
+		 * scratch, so it can also be used to clear accumulated rounding error.
+		 * Copies inherit the setting. */
+		void SetLogPotentialTracking( bool enable );
+		bool IsTrackingLogPotential() const;
+
+		/*! \brief Returns the running total log-potential in constant time.
+		 * Requires tracking to be enabled. Returns -infinity if any potential is 0. */
+		double GetLogPotential() const;
+
+		/*! \brief Packs the variable to potential and potential to clique lookups
+		 * into CSR tables. Adding variables or potentials invalidates the tables. */
+		void BuildAdjacency();
+
+		/*! \brief Returns whether the CSR tables are current. */
+		bool HasAdjacency() const;
+
+		/*! \brief Throws std::logic_error unless HasAdjacency(). */
+		void RequireAdjacency() const;
+
+		/*! \brief Retrieve the potential IDs for a variable from the CSR tables.
+		 * Requires HasAdjacency(). */
+		IDRange GetVariableAdjacency( unsigned int varID ) const {
+			assert( topology->adjacencyValid );
+			const Topology& t = *topology;
+			return IDRange( t.variablePotentialIndices.data() + t.variablePotentialOffsets[varID],
+							t.variablePotentialIndices.data() + t.variablePotentialOffsets[varID+1] );
+		}
+
+		/*! \brief Retrieve the position of a variable within the clique of each
+		 * potential in GetVariableAdjacency(), in the same order. Requires
+		 * HasAdjacency(). */
+		IDRange GetVariableAdjacencyPositions( unsigned int varID ) const {
+			assert( topology->adjacencyValid );
+			const Topology& t = *topology;
+			return IDRange( t.variablePotentialPositions.data() + t.variablePotentialOffsets[varID],
+							t.variablePotentialPositions.data() + t.variablePotentialOffsets[varID+1] );
+		}
+
+		/*! \brief Greedily colors the variables so that no two variables sharing a
+		 * potential have the same color. Each color class is then conditionally
+		 * independent given the others. Builds the adjacency tables if needed. */
+		void BuildColoring();
+
+		/*! \brief Returns whether the coloring is current. */
+		bool HasColoring() const;
+
+		/*! \brief Retrieve the number of colors and a variable's color. Requires
+		 * HasColoring(). */
+		unsigned int NumColors() const;
+		unsigned int GetColor( unsigned int varID ) const {
+			assert( HasColoring() );
+			return topology->variableColors[varID];
+		}
+
+		/*! \brief Returns whether any potential keeps statistics in this field. */
+		bool HasStatistics() const;
+
+		/*! \brief Retrieve the clique variable IDs for a potential from the CSR
+		 * tables. Requires HasAdjacency(). */
+		IDRange GetPotentialAdjacency( unsigned int potID ) const {
+			assert( topology->adjacencyValid );
+			const Topology& t = *topology;
+			return IDRange( t.potentialCliqueIndices.data() + t.potentialCliqueOffsets[potID],
+							t.potentialCliqueIndices.data() + t.potentialCliqueOffsets[potID+1] );
+		}
+
 	private:
 
-		typedef std::unordered_map <unsigned int, GibbsVariable::Ptr> VariableMap;
-		typedef std::unordered_map <unsigned int, GibbsPotential::Ptr> PotentialMap;
-		
-		/*! \brief Map from variable IDs to pointers. */
-		VariableMap variables;
+		/*! \brief Everything about the field that does not change during sampling. */
+		struct Topology {
+
+			Topology();
+
+			/*! \brief Variables indexed by ID. */
+			std::vector<GibbsVariable::Ptr> variables;
+
+			/*! \brief Potentials indexed by ID. */
+			std::vector<GibbsPotential::Ptr> potentials;
+
+			/*! \brief Whether the CSR tables reflect the current variables and potentials. */
+			bool adjacencyValid;
+
+			/*! \brief CSR table from variables to potentials. Row i spans
+			 * [offsets[i], offsets[i+1]) in the index array. */
+			std::vector<unsigned int> variablePotentialOffsets;
+			std::vector<unsigned int> variablePotentialIndices;
+
+			/*! \brief Parallel to the indices above, the variable's position in
+			 * each potential's clique. */
+			std::vector<unsigned int> variablePotentialPositions;
+
+			/*! \brief CSR table from potentials to their clique variables. */
+			std::vector<unsigned int> potentialCliqueOffsets;
+			std::vector<unsigned int> potentialCliqueIndices;
+
+			/*! \brief Each potential's slice of the statistics array spans
+			 * [offsets[i], offsets[i+1]). */
+			std::vector<unsigned int> statisticOffsets;
+
+			/*! \brief Whether the coloring reflects the current potentials. */
+			bool coloringValid;
+			unsigned int numColors;
+			std::vector<unsigned int> variableColors;
+		};
+
+		/*! \brief The topology, shared with all copies of this field. Treated as
+		 * immutable while shared; modifications go through MutableTopology(). */
+		std::shared_ptr<Topology> topology;
+
+		/*! \brief Per-variable states indexed by ID. */
+		PackedStateArray states;
+
+		/*! \brief Running statistics of all potentials that keep them. Empty if
+		 * none do. */
+		std::vector<double> statistics;
+
+		/*! \brief Whether the running log-potential below is maintained. */
+		bool trackLogPotential;
+
+		/*! \brief The sum of the finite potential logs. Zero potentials are
+		 * counted separately so that -infinity never enters the sum, where removing
+		 * it again would give NaN. Updates still accumulate rounding error, which
+		 * SetLogPotentialTracking( true ) clears by recomputing the total. */
+		double finiteLogSum;
+		unsigned int numZeroPotentials;
+
+		/*! \brief Applies a change of state of a variable to the statistics of
+		 * its adjacent potentials. */
+		void UpdateStatistics( unsigned int varID, unsigned char oldState, unsigned char newState );
+
+		/*! \brief Recomputes the statistics of a potential from the states. */
+		void InitializeStatistics( unsigned int potID );
+
+		/*! \brief Adds the current logs of the potentials adjacent to a variable
+		 * to the running total, or removes them. */
+		void AccumulateTrackedPotentials( unsigned int varID, bool add );
+
+		/*! \brief Adds a potential's log value to the running total, or removes it. */
+		void AccumulateTrackedPotential( double logValue, bool add );
+
+		/*! \brief Returns a topology that only this field refers to, copying the
+		 * shared one if necessary. */
+		Topology& MutableTopology();
 
-		/*! \brief Map from potential IDs to pointers. */
-		PotentialMap potentials;
-		
 	};
-	
+
+	inline unsigned char CliqueStates::operator[]( std::size_t i ) const {
+		if( values ) {
+			return values[i];
+		}
+		const unsigned int varID = ids[i];
+		return varID == candidateID ? candidateState : field->GetState( varID );
+	}
+
 }
 
-#endif
\ No newline at end of file
+#endif
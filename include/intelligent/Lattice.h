@@ -4,16 +4,31 @@
 #include "intelligent/GibbsField.h"
 #include "intelligent/DiscretePoint.h"
 
+#include <limits>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/function.hpp>
 
 namespace intelligent {
 
-	/*! \brief Arranges node IDs into a 3D cubical lattice. */
+	/*! \brief Arranges node IDs into a 3D cubical lattice. Positions are kept in
+	 * a flat array indexed by ID, and IDs in a dense 3D grid over the bounding box
+	 * so that lookups in either direction are a few arithmetic operations. The grid
+	 * carries slack so growing it is amortized; if the nodes fill too little of
+	 * their bounding box the lattice falls back to a hash map from positions. */
 	class Lattice {
 	public:
 
+		/*! \brief Marks grid cells without a node. */
+		static const unsigned int NoNode = std::numeric_limits<unsigned int>::max();
+
+		/*! \brief The grid stays dense while it has at most this many cells per
+		 * node, or fewer than MinSparseCells cells. */
+		static const std::size_t MaxCellsPerNode = 8;
+		static const std::size_t MinSparseCells = 4096;
+
 		/*! \brief Creates an empty lattice with bounding box minima set to
 		 * +infinity and maxima set to -infinity. */
 		Lattice();
@@ -23,32 +38,74 @@ namespace intelligent {
 		/*! \brief Inserts a node into this lattice. */
 		void AddNode( unsigned int ID, const DiscretePoint3& pos );
 
-		/*! \brief Retrieve the position corresponding to an ID. */
+		/*! \brief Allocates the dense grid over the specified box ahead of time, so
+		 * filling it with AddNode() never regrows or falls back to sparse. */
+		void Reserve( const DiscreteBox3& box );
+
+		/*! \brief Returns whether positions are looked up in the dense grid rather
+		 * than the sparse fallback. */
+		bool IsDense() const;
+
+		/*! \brief Retrieve the position corresponding to an ID. Throws
+		 * std::out_of_range if there is no such node. */
 		DiscretePoint3 GetNodePosition( unsigned int id ) const;
 
-		/*! \brief Retrieve the node from position or ID. */
+		/*! \brief Retrieve the node from position or ID. Throws std::out_of_range
+		 * if there is no node at the position. */
 		unsigned int GetNodeID( const DiscretePoint3& pos ) const;
 
-		/*! \brief Retrieve all node IDs. Order is undefined. */
+		/*! \brief Sets id to the node at the position and returns true, or returns
+		 * false if there is none. */
+		bool TryGetNodeID( const DiscretePoint3& pos, unsigned int& id ) const;
+
+		/*! \brief Retrieve all node IDs in increasing order. */
 		std::vector<unsigned int> GetNodeIDs() const;
 
 		/*! \brief Return this lattice's bounding box. */
 		DiscreteBox3 GetBoundingBox() const;
+
+		/*! \brief Groups the specified node IDs into vertical columns, one per
+		 * (x, y) position, each ordered by increasing z. Columns are ordered by x,
+		 * then y. For blocked sampling with MCMCSampler::SetBlocks(). */
+		std::vector< std::vector<unsigned int> >
+		GetColumns( const std::vector<unsigned int>& ids ) const;
 		
 	private:
 
-		typedef std::unordered_map <unsigned int, DiscretePoint3> IDPositionMap;
 		typedef std::unordered_map <DiscretePoint3, unsigned int> PositionIDMap;
 		
-		/*! \brief Map from node IDs to positions. */
-		IDPositionMap idPositionMap;
+		/*! \brief Node positions indexed by ID. Entries for IDs never added are
+		 * recognized by not mapping back to their ID. */
+		std::vector<DiscretePoint3> positions;
 
-		/*! \brief Map from positions to node IDs. */
+		unsigned int numNodes;
+
+		/*! \brief Node IDs over gridBox with z varying fastest, then y, matching
+		 * DiscreteBox3::Iterate(). Empty when sparse. */
+		std::vector<unsigned int> grid;
+		DiscreteBox3 gridBox;
+		bool dense;
+
+		/*! \brief Map from positions to node IDs, used only when sparse. */
 		PositionIDMap positionIDMap;
 
+		/*! \brief The node count at which a sparse lattice next checks whether it
+		 * has filled in enough to go dense. */
+		unsigned int nextDenseCheck;
+
 		/*! \brief The bounding box around this lattice. */
 		DiscreteBox3 boundingBox;
 
+		/*! \brief Returns the ID at the position, or NoNode. */
+		unsigned int LookupNode( const DiscretePoint3& pos ) const;
+
+		/*! \brief Returns the grid cell of a position inside gridBox. */
+		std::size_t GridIndex( const DiscretePoint3& pos ) const;
+
+		/*! \brief Rebuilds the position lookup over the specified box if dense,
+		 * or as a hash map if not. */
+		void Relayout( const DiscreteBox3& box, bool makeDense );
+
 	};
 	
 }
@@ -1,9 +1,11 @@
 #ifndef _MCMC_SAMPLER_H_
 #define _MCMC_SAMPLER_H_
 
+#include "intelligent/AnnealingSchedule.h"
+#include "intelligent/ChainSampler.h"
 #include "intelligent/GibbsField.h"
-
-#include <random>
+#include "intelligent/ThreadPool.h"
+#include "intelligent/RandomDistributions.h"
 
 namespace intelligent {
 
@@ -11,27 +13,205 @@ namespace intelligent {
 	class MCMCSampler {
 	public:
 
+		/*! \brief How Sweep() visits the sampled variables. */
+		enum SweepType {
+			SWEEP_SYSTEMATIC, // In increasing ID order, which follows the lattice
+			SWEEP_PERMUTED, // In a fresh random order each sweep
+			SWEEP_CHROMATIC, // By color class, see SampleChromatic()
+			SWEEP_RESIDUAL, // In increasing ID order, skipping settled variables
+			SWEEP_BLOCKED // Chains of variables jointly, see SampleBlocked()
+		};
+
 		MCMCSampler();
 
 		/*! \brief Seeds with the current system time. */
 		void SeedDistribution();
 
+		/*! \brief Restarts the generator at the beginning of the specified stream
+		 * of the seed. A sampler given the same seed and stream makes the same
+		 * draws, whatever thread pool it runs on. */
+		void SetSeed( uint64_t seed, uint64_t stream = 0 );
+		uint64_t GetSeed() const;
+		uint64_t GetStream() const;
+
+		/*! \brief Returns a sampler with the same settings, thread pool and seed
+		 * that draws from a new stream chosen by this sampler's generator, for
+		 * running an independent chain. */
+		MCMCSampler Fork();
+
 		/*! \brief Sets valid sampling indices. */
 		void SetIndexSet( const std::vector<unsigned int>& ind );
 		
 		/*! \brief Runs Monte Carlo Markov Chain sampling on the given Gibbs field
 		 * for a specified number of samples. Note that running this function with
-		 * multiple samples is faster than calling it multiple times in sequence. */
+		 * multiple samples is faster than calling it multiple times in sequence.
+		 * Does nothing if the index set is empty. */
 		void Sample( GibbsField& field, unsigned int numSamples = 1 );
 
+		/*! \brief Sets the pool that SampleChromatic() runs on. Without a pool,
+		 * chromatic sweeps run on the calling thread. */
+		void SetThreadPool( const ThreadPool::Ptr& _pool );
+
+		/*! \brief Runs a number of chromatic sweeps on the given Gibbs field. The
+		 * field's variables are colored so that no two sharing a potential have the
+		 * same color, and each sweep samples every color class in turn, drawing all
+		 * members of a class concurrently on the thread pool. Each update draws
+		 * from a generator step addressed by its sweep and variable ID, so results
+		 * do not depend on the number of threads. Respects the index set. The
+		 * field must not keep statistics, since global potentials would couple
+		 * every variable. */
+		void SampleChromatic( GibbsField& field, unsigned int numSweeps = 1 );
+
+		/*! \brief Sets the chains of variables that blocked sweeps sample
+		 * jointly, such as the columns from Lattice::GetColumns(). Each chain must
+		 * be ordered so that its variables share potentials only within
+		 * ChainSampler::MaxOrder positions, and no variable may be in two chains.
+		 * Variables outside every chain are not sampled by blocked sweeps. */
+		void SetBlocks( const std::vector< std::vector<unsigned int> >& _blocks );
+
+		/*! \brief Runs a number of blocked sweeps on the given Gibbs field. Each
+		 * sweep draws every chain jointly from its conditional given the rest of
+		 * the field by forward filtering and backward sampling. Chains that share
+		 * no potential are grouped into classes, such as a checkerboard of
+		 * columns, and the members of a class are drawn concurrently on the
+		 * thread pool. Results do not depend on the number of threads. The field
+		 * must not keep statistics. */
+		void SampleBlocked( GibbsField& field, unsigned int numSweeps = 1 );
+
+		/*! \brief Sets how Sweep() orders its updates. Defaults to systematic. */
+		void SetSweepType( SweepType type );
+		SweepType GetSweepType() const;
+
+		/*! \brief Runs a number of sweeps on the given Gibbs field, each of which
+		 * updates every variable in the index set exactly once. Residual sweeps
+		 * instead update only the variables that a neighbor's change has made
+		 * dirty since they were last sampled, or whose last conditional was not
+		 * settled, plus a random fraction of the rest set by SetRefreshRate().
+		 * Their flags carry over between calls on the same field; variables whose
+		 * states changed elsewhere in between make their neighbors dirty. A
+		 * different field, index set or tolerance starts over with every variable
+		 * dirty. */
+		void Sweep( GibbsField& field, unsigned int numSweeps = 1 );
+
+		/*! \brief Sets how close to deterministic a conditional must be for a
+		 * residual sweep to treat its variable as settled: its most likely state
+		 * had at least 1 - tolerance probability. Defaults to 1e-3. */
+		void SetResidualTolerance( double tolerance );
+
+		/*! \brief Sets the probability that a residual sweep resamples a settled
+		 * variable that is not dirty. Defaults to 0.05. */
+		void SetRefreshRate( double rate );
+
+		/*! \brief Returns the number of variable updates made by the last call to
+		 * Sweep(). */
+		std::size_t GetNumUpdates() const;
+
+		/*! \brief Sets the inverse temperature beta. Updates draw from their
+		 * conditionals raised to the power beta, so values above 1 concentrate
+		 * the field on high-potential states and 0 ignores every potential except
+		 * hard zeros. Defaults to 1, which is plain Gibbs sampling. */
+		void SetInverseTemperature( double beta );
+		double GetInverseTemperature() const;
+
+		/*! \brief Sets a schedule that chooses the inverse temperature before
+		 * each sweep, counting sweeps from this call across later calls to
+		 * Sweep(). Sample() uses the current inverse temperature without
+		 * advancing the schedule. A null schedule keeps the last temperature. */
+		void SetAnnealingSchedule( const AnnealingSchedule::Ptr& _schedule );
+
 		bool hasIndices;
 
 	private:
+
+		/*! \brief Each thread gets several chunks of a color class to balance load. */
+		static const unsigned int ChunksPerThread = 4;
+
+		/*! \brief The most updates whose random numbers are drawn at once. */
+		static const unsigned int BatchSize = 4096;
 		
-		std::random_device rd;
-		std::mt19937 generator;
+		PhiloxEngine generator;
 		// bool hasIndices;
 		std::vector<unsigned int> indices;
+
+		SweepType sweepType;
+
+		/*! \brief The variables visited by systematic, permuted and residual sweeps. */
+		std::vector<unsigned int> sweepOrder;
+		std::size_t numUpdates;
+
+		double residualTolerance;
+		double refreshRate;
+
+		/*! \brief Per variable flags for residual sweeps. */
+		std::vector<unsigned char> residualDirty;
+		std::vector<unsigned char> residualSettled;
+
+		/*! \brief The field the flags describe, or null if they describe none, and
+		 * its potential count and states when the last residual sweep ended. Only
+		 * compared against, never dereferenced. */
+		const GibbsField* residualField;
+		std::size_t residualNumPotentials;
+		PackedStateArray residualStates;
+
+		/*! \brief Runs residual sweeps over the sweep order. */
+		void SweepResidual( GibbsField& field, unsigned int numSweeps );
+
+		/*! \brief Marks a variable and every variable sharing a potential without
+		 * statistics with it as dirty. */
+		void MarkResidualDirty( const GibbsField& field, unsigned int varID );
+
+		double inverseTemperature;
+		AnnealingSchedule::Ptr schedule;
+		unsigned int scheduleSweep;
+
+		/*! \brief Updates and state changes made so far by the current sweep. */
+		std::size_t sweepUpdates;
+		std::size_t sweepChanges;
+
+		/*! \brief Whether updates must draw from tempered conditionals rather
+		 * than through GibbsVariable::SampleState(). */
+		bool IsTempered() const;
+
+		/*! \brief Advances the annealing schedule, if any, from the statistics of
+		 * the last sweep and clears them. */
+		void BeginSweep();
+
+		/*! \brief Draws a state for the variable from its conditional raised to
+		 * the inverse temperature. If settled is given, it is set to whether the
+		 * most likely state had at least 1 - residualTolerance probability. Does
+		 * not modify the sampler or field, so it may be called concurrently. */
+		unsigned char DrawConditional( const GibbsField& field, unsigned int varID,
+									   double rng, bool* settled = nullptr ) const;
+
+		/*! \brief Samples the variable, through a tempered draw if needed, and
+		 * counts whether it changed. */
+		void UpdateVariable( GibbsField& field, unsigned int varID, double rng, bool tempered );
+
+		ThreadPool::Ptr pool;
+
+		/*! \brief Random numbers for a batch of updates, drawn in bulk by DrawBatch(). */
+		std::vector<PhiloxEngine::result_type> batchWords;
+		std::vector<unsigned int> batchSites;
+		std::vector<double> batchUniforms;
+
+		/*! \brief Fills batchUniforms with numDraws uniforms and, if numSites is
+		 * nonzero, batchSites with as many positions in [0, numSites). */
+		void DrawBatch( unsigned int numDraws, std::size_t numSites );
+
+		/*! \brief Scratch space for chromatic sweeps. */
+		std::vector< std::vector<unsigned int> > colorClasses;
+		std::vector<unsigned char> drawnStates;
+		std::vector<std::size_t> chunkBounds;
+		std::vector<std::size_t> chunkChanges;
+
+		/*! \brief Chains for blocked sweeps, and scratch space rebuilt from them
+		 * for each field. Drawn states of chain c start at blockStarts[c]. */
+		std::vector< std::vector<unsigned int> > blocks;
+		std::vector<ChainSampler> chainSamplers;
+		std::vector< std::vector<unsigned int> > blockClasses;
+		std::vector<std::size_t> blockStarts;
+		std::vector<ChainSampler::Workspace> chunkWorkspaces;
+		std::vector< std::vector<double> > chunkUniforms;
 		
 	};
 	
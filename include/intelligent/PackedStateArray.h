@@ -0,0 +1,148 @@
+#ifndef _PACKED_STATE_ARRAY_H_
+#define _PACKED_STATE_ARRAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace intelligent {
+
+	/*! \brief A dense array of small discrete states packed at two bits each.
+	 *
+	 * States are stored 32 to a 64-bit word, lowest index in the lowest bits.
+	 * Unused bits in the last word are kept at zero so that whole-word operations
+	 * such as counting never need to special-case the tail. */
+	class PackedStateArray {
+	public:
+
+		typedef uint64_t Word;
+
+		static const unsigned int BitsPerState = 2;
+		static const unsigned int StatesPerWord = 32;
+
+		/*! \brief The number of distinct values a state can take. */
+		static const unsigned int MaxStates = 4;
+
+		PackedStateArray();
+
+		/*! \brief Creates an array of n states all set to fill. */
+		PackedStateArray( std::size_t n, unsigned char fill = 0 );
+
+		std::size_t size() const { return numStates; }
+		bool empty() const { return numStates == 0; }
+
+		/*! \brief Changes the number of states, setting new ones to fill. */
+		void resize( std::size_t n, unsigned char fill = 0 );
+
+		void push_back( unsigned char state );
+
+		/*! \brief Retrieve or set a single state. Unchecked. */
+		unsigned char Get( std::size_t i ) const {
+			return ( words[ i / StatesPerWord ] >> Shift( i ) ) & StateMask;
+		}
+
+		void Set( std::size_t i, unsigned char state ) {
+			Word& w = words[ i / StatesPerWord ];
+			const unsigned int shift = Shift( i );
+			w = ( w & ~( Word( StateMask ) << shift ) ) | ( Word( state & StateMask ) << shift );
+		}
+
+		unsigned char operator[]( std::size_t i ) const { return Get( i ); }
+
+		/*! \brief Unpack count states starting at first into out. */
+		void GetRange( std::size_t first, std::size_t count, unsigned char* out ) const;
+
+		/*! \brief Pack count states from in starting at first. */
+		void SetRange( std::size_t first, std::size_t count, const unsigned char* in );
+
+		/*! \brief Set every state to the specified value. */
+		void Fill( unsigned char state );
+
+		/*! \brief Count the states equal to the specified value. */
+		std::size_t Count( unsigned char state ) const;
+
+		/*! \brief Count the states not equal to 0. */
+		std::size_t CountNonZero() const;
+
+		/*! \brief Call op( index, state ) for every index in [first, last). */
+		template <class Op>
+		void ForEach( std::size_t first, std::size_t last, Op op ) const {
+			for( std::size_t i = first; i < last; ) {
+				Word w = words[ i / StatesPerWord ] >> Shift( i );
+				std::size_t wordEnd = ( i / StatesPerWord + 1 ) * StatesPerWord;
+				if( wordEnd > last ) { wordEnd = last; }
+				for( ; i < wordEnd; i++, w >>= BitsPerState ) {
+					op( i, static_cast<unsigned char>( w & StateMask ) );
+				}
+			}
+		}
+
+		template <class Op>
+		void ForEach( Op op ) const {
+			ForEach( 0, numStates, op );
+		}
+
+		/*! \brief Call op( index, state ) for every non-zero state in index order.
+		 * All-zero words are skipped, so this is cheap on sparse arrays. */
+		template <class Op>
+		void ForEachNonZero( Op op ) const {
+			for( std::size_t wi = 0; wi < words.size(); wi++ ) {
+				Word w = words[wi];
+				while( w != 0 ) {
+					unsigned int slot = CountTrailingZeros( w ) / BitsPerState;
+					unsigned int shift = slot * BitsPerState;
+					op( wi * StatesPerWord + slot,
+						static_cast<unsigned char>( ( w >> shift ) & StateMask ) );
+					w &= ~( Word( StateMask ) << shift );
+				}
+			}
+		}
+
+		/*! \brief Bytes of heap storage used by the packed words. */
+		std::size_t MemoryUsage() const;
+
+		bool operator==( const PackedStateArray& other ) const;
+		bool operator!=( const PackedStateArray& other ) const;
+
+	private:
+
+		static const Word StateMask = 0x3;
+
+		/*! \brief Mask selecting the low bit of every state in a word. */
+		static const Word LowBits = 0x5555555555555555ULL;
+
+		std::size_t numStates;
+		std::vector<Word> words;
+
+		static unsigned int Shift( std::size_t i ) {
+			return ( i % StatesPerWord ) * BitsPerState;
+		}
+
+		/*! \brief Mask selecting the bits of valid states in word wi. */
+		Word ValidMask( std::size_t wi ) const;
+
+		static unsigned int PopCount( Word w ) {
+#ifdef __GNUC__
+			return __builtin_popcountll( w );
+#else
+			w = w - ( ( w >> 1 ) & LowBits );
+			w = ( w & 0x3333333333333333ULL ) + ( ( w >> 2 ) & 0x3333333333333333ULL );
+			w = ( w + ( w >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+			return ( w * 0x0101010101010101ULL ) >> 56;
+#endif
+		}
+
+		/*! \brief Index of the lowest set bit. w must be non-zero. */
+		static unsigned int CountTrailingZeros( Word w ) {
+#ifdef __GNUC__
+			return __builtin_ctzll( w );
+#else
+			return PopCount( ( w & -w ) - 1 );
+#endif
+		}
+
+	};
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _PARALLEL_TEMPERING_H_
+#define _PARALLEL_TEMPERING_H_
+
+#include "intelligent/DiscreteAssembly.h"
+#include "intelligent/MCMCSampler.h"
+
+namespace intelligent {
+
+	/*! \brief Replica exchange sampling of DiscreteAssembly fields. Replicas run
+	 * at a ladder of inverse temperatures, and after every round of sweeps
+	 * neighboring rungs propose to swap configurations. Hot replicas cross the
+	 * barriers formed by zero potentials and pass their states down to the
+	 * cold replica at inverse temperature 1, which samples the field itself. */
+	class ParallelTempering {
+	public:
+
+		/*! \brief Construct a driver that runs one fork of the specified sampler
+		 * per rung of the ladder. Inverse temperatures must be non-negative and
+		 * are sorted in increasing order. */
+		ParallelTempering( MCMCSampler& _sampler, const std::vector<double>& _inverseTemperatures );
+
+		/*! \brief Returns a ladder of numReplicas inverse temperatures spaced
+		 * geometrically from minBeta up to 1. */
+		static std::vector<double> GeometricLadder( double minBeta, unsigned int numReplicas );
+
+		/*! \brief Sets a pool on which the replicas sweep concurrently. */
+		void SetThreadPool( const ThreadPool::Ptr& _pool );
+
+		/*! \brief Starts every replica from a copy of the assembly and clears the
+		 * swap statistics. */
+		void SetBase( const DiscreteAssembly::Ptr& assembly );
+
+		/*! \brief Runs a number of rounds. In each round every replica makes
+		 * sweepsPerRound sweeps at its temperature, then neighboring rungs
+		 * propose swaps, alternating between even and odd pairs by round. */
+		void Run( unsigned int numRounds, unsigned int sweepsPerRound = 1 );
+
+		unsigned int NumReplicas() const;
+		double GetInverseTemperature( unsigned int rung ) const;
+
+		/*! \brief Returns the replica currently at the specified rung. */
+		DiscreteAssembly::Ptr GetReplica( unsigned int rung ) const;
+
+		/*! \brief Returns the replica at the coldest rung. */
+		DiscreteAssembly::Ptr GetColdReplica() const;
+
+		/*! \brief Returns the fraction of accepted swaps between each rung and the
+		 * next, for tuning the ladder. Rungs that have not proposed report 0. */
+		std::vector<double> GetSwapRates() const;
+
+	private:
+
+		std::vector<double> inverseTemperatures;
+		std::vector<MCMCSampler> samplers;
+		std::vector<DiscreteAssembly::Ptr> replicas;
+		ThreadPool::Ptr pool;
+
+		/*! \brief Draws the swap decisions from a stream of the sampler's seed. */
+		PhiloxEngine swapGenerator;
+		unsigned int numRounds;
+
+		std::vector<std::size_t> swapsProposed;
+		std::vector<std::size_t> swapsAccepted;
+
+		/*! \brief Proposes a swap of the replicas at a rung and the next. */
+		void ProposeSwap( unsigned int rung );
+
+	};
+
+}
+
+#endif
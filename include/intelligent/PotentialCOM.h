@@ -12,24 +12,33 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialCOM> Ptr;
 		
-		PotentialCOM(const GibbsField& _field, unsigned int _id,
+		PotentialCOM(unsigned int _id,
 			const std::vector<unsigned int> & _vids, 
 			const Lattice & _lattice);
 
-		PotentialCOM(const GibbsField & _field, const GibbsPotential & other);
+		virtual double Evaluate(const CliqueStates& states) const;
+		virtual double EvaluateLog(const CliqueStates& states) const;
 
-		virtual GibbsPotential::Ptr Clone(const GibbsField& _field);
-		
-		virtual double CalculatePotential();
+		/*! \brief Keeps the total mass and its first moments, in that order. */
+		virtual unsigned int NumStatistics() const;
+		virtual void InitializeStatistics(const CliqueStates& states, double* stats) const;
+		virtual void UpdateStatistics(std::size_t cliqueIndex, unsigned char oldState,
+									  unsigned char newState, double* stats) const;
+		virtual double EvaluateStatistics(const double* stats) const;
+		virtual double EvaluateLogStatistics(const double* stats) const;
 		
 		void SetDesiredCOM(const ContinuousPoint3& _com);
 		
-		const Lattice * lattice;
 		ContinuousPoint3 desiredCOM;
 
 	private:
 
-		ContinuousPoint3 CalculateCOM();
+		/*! \brief Lattice positions of the clique variables, in clique order. */
+		std::vector<DiscretePoint3> positions;
+
+		/*! \brief L1 distance from the desired COM of the COM described by the
+		 * statistics. */
+		double CalculateDeviation(const double* stats) const;
 		
 	};
 
@@ -14,15 +14,11 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialEdge> Ptr;
 		
-		PotentialEdge( const GibbsField& _field, unsigned int _id,
-					   const std::vector<unsigned int>& _variableIDs,
+		PotentialEdge( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
 					   const Lattice& _lattice );
 
-		PotentialEdge( const GibbsField& _field, const PotentialEdge& other );
-
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-		
-		virtual double CalculatePotential();
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
 		
 		bool edge;
 	};
@@ -11,15 +11,12 @@ namespace intelligent {
 		
 		typedef std::shared_ptr<PotentialFixed> Ptr;
 
-		PotentialFixed( const GibbsField& _field, unsigned int _id,
-						const std::vector<unsigned int>& _variableIDs,
+		PotentialFixed( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
 						BlockType fix );
 
-		PotentialFixed( const GibbsField& _field, const PotentialFixed& other );
-
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-
-		virtual double CalculatePotential();
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
+		virtual bool IsEquivalent( const GibbsPotential& other ) const;
 		
 	private:
 
@@ -14,20 +14,17 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialHeight> Ptr;
 		
-		PotentialHeight( const GibbsField& _field, unsigned int _id,
-					   const std::vector<unsigned int>& _variableIDs,
-					   const Lattice& _lattice );
+		PotentialHeight( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
+						 const Lattice& _lattice );
 
-		PotentialHeight( const GibbsField& _field, const PotentialHeight& other );
-
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-		
-		virtual double CalculatePotential();
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
 
 	private:
 		
 		int nodeHeight;
 		int latticeHeight;
+		double logNodeHeight;
 
 	};
 
@@ -12,15 +12,19 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialMass> Ptr;
 		
-		PotentialMass( const GibbsField& _field, unsigned int _id,
-					   const std::vector<unsigned int>& _variableIDs,
+		PotentialMass( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
 					   double _massCoeff, double _maxMass );
 
-		PotentialMass( const GibbsField& _field, const PotentialMass& other );
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
 
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-		
-		virtual double CalculatePotential();
+		/*! \brief Keeps the total mass of the clique as its only statistic. */
+		virtual unsigned int NumStatistics() const;
+		virtual void InitializeStatistics( const CliqueStates& states, double* stats ) const;
+		virtual void UpdateStatistics( std::size_t cliqueIndex, unsigned char oldState,
+									   unsigned char newState, double* stats ) const;
+		virtual double EvaluateStatistics( const double* stats ) const;
+		virtual double EvaluateLogStatistics( const double* stats ) const;
 
 	private:
 
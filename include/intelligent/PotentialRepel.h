@@ -15,15 +15,11 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialRepel> Ptr;
 		
-		PotentialRepel( const GibbsField& _field, unsigned int _id,
-					   const std::vector<unsigned int>& _variableIDs,
+		PotentialRepel( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
 					   const Lattice& _lattice, const ContinuousPoint3 _objPos );
 
-		PotentialRepel( const GibbsField& _field, const PotentialRepel& other );
-
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-		
-		virtual double CalculatePotential();
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
 		
 		double distance;
 
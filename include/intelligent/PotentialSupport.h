@@ -12,14 +12,12 @@ namespace intelligent {
 
 		typedef std::shared_ptr<PotentialSupport> Ptr;
 		
-		PotentialSupport( const GibbsField& _field, unsigned int _id,
-						  const std::vector<unsigned int>& _variableIDs );
+		PotentialSupport( unsigned int _id, const std::vector<unsigned int>& _variableIDs );
 
-		PotentialSupport( const GibbsField& _field, const PotentialSupport& other );
+		virtual double Evaluate( const CliqueStates& states ) const;
 
-		virtual GibbsPotential::Ptr Clone( const GibbsField& _field );
-		
-		virtual double CalculatePotential();
+		/*! \brief Support potentials have no parameters, so all are equivalent. */
+		virtual bool IsEquivalent( const GibbsPotential& other ) const;
 		
 	};
 
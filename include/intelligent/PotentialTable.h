@@ -0,0 +1,104 @@
+#ifndef _POTENTIAL_TABLE_H_
+#define _POTENTIAL_TABLE_H_
+
+#include "intelligent/GibbsField.h"
+
+namespace intelligent {
+
+	/*! \brief A dense table of a potential's value over every joint state of its
+	 * clique. Entries are addressed by a mixed-radix index in which clique variable
+	 * i contributes state*stride[i], with the first variable varying fastest. Tables
+	 * are immutable and may be shared by any number of equivalent potentials. */
+	class PotentialTable {
+	public:
+
+		typedef std::shared_ptr<const PotentialTable> Ptr;
+
+		/*! \brief The default largest table built, enough for ten ternary variables. */
+		static const std::size_t DefaultMaxEntries = 59049;
+
+		/*! \brief Enumerates the potential over all joint states. radices[i] is the
+		 * number of states of the i-th clique variable. */
+		PotentialTable( const GibbsPotential& pot, const std::vector<unsigned int>& radices );
+
+		/*! \brief Builds a table directly from log values in index order. Zero
+		 * potentials are given as -infinity. */
+		PotentialTable( const std::vector<unsigned int>& radices,
+						const std::vector<double>& _logValues );
+
+		/*! \brief Returns the number of entries a table with the specified radices
+		 * would have, or 0 if it would overflow. */
+		static std::size_t CountEntries( const std::vector<unsigned int>& radices );
+
+		std::size_t size() const { return values.size(); }
+		std::size_t NumVariables() const { return strides.size(); }
+
+		/*! \brief The index increment for one state of the i-th clique variable. */
+		std::size_t GetStride( std::size_t i ) const { return strides[i]; }
+
+		/*! \brief Compute the table index of the specified clique states. */
+		std::size_t ComputeIndex( const CliqueStates& states ) const {
+			std::size_t index = 0;
+			for( std::size_t i = 0; i < strides.size(); i++ ) {
+				index += states[i]*strides[i];
+			}
+			return index;
+		}
+
+		double GetValue( std::size_t index ) const { return values[index]; }
+		double GetLogValue( std::size_t index ) const { return logValues[index]; }
+
+	private:
+
+		void ComputeStrides( const std::vector<unsigned int>& radices );
+
+		std::vector<std::size_t> strides;
+		std::vector<double> values;
+		std::vector<double> logValues;
+
+	};
+
+	/*! \brief A potential that evaluates by looking up a PotentialTable. Produced
+	 * by TabulatePotentials() to replace small-clique potentials after a field is
+	 * built, so evaluation costs an index computation and a load. */
+	class TabulatedPotential : public GibbsPotential {
+	public:
+
+		typedef std::shared_ptr<TabulatedPotential> Ptr;
+
+		TabulatedPotential( unsigned int _id, const std::vector<unsigned int>& _variableIDs,
+							const PotentialTable::Ptr& _table );
+
+		virtual double Evaluate( const CliqueStates& states ) const;
+		virtual double EvaluateLog( const CliqueStates& states ) const;
+
+		/*! \brief Looks up all candidates with a single pass over the clique. */
+		virtual void CalculateCandidatePotentials( const GibbsField& field, unsigned int varID,
+												   unsigned int numStates, double* out ) const;
+		virtual void CalculateCandidateLogPotentials( const GibbsField& field, unsigned int varID,
+													  unsigned int numStates, double* out ) const;
+
+		const PotentialTable::Ptr& GetTable() const;
+
+	private:
+
+		PotentialTable::Ptr table;
+
+		/*! \brief Compute the index of the clique states with varID in state 0,
+		 * and the stride of varID. */
+		void ComputeCandidateIndex( const GibbsField& field, unsigned int varID,
+									std::size_t& base, std::size_t& step ) const;
+
+	};
+
+	/*! \brief Replaces every potential in the field whose joint state space has at
+	 * most maxEntries entries with a TabulatedPotential. Potentials that keep
+	 * statistics are left as they are. Consecutive potentials of the
+	 * same type that report IsEquivalent() share one table. Returns the number of
+	 * potentials replaced. */
+	unsigned int TabulatePotentials( GibbsField& field,
+									 std::size_t maxEntries = PotentialTable::DefaultMaxEntries );
+
+}
+
+#endif
@@ -5,11 +5,220 @@
 #include <boost/random/normal_distribution.hpp>
 #include <boost/random/uniform_01.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
 namespace intelligent {
 
+	/*! \brief A counter-based Philox4x32-10 random number generator. Output is a
+	 * pure function of a (seed, stream, step) address, where each step is a block of
+	 * four 32-bit words, so any position of any stream can be computed directly
+	 * without running the generator up to it. Streams of one seed are independent,
+	 * which lets parallel chains and chunks draw reproducibly however the work is
+	 * divided between threads. Satisfies the standard uniform random bit generator
+	 * requirements, so it works with both std and boost distributions. */
+	class PhiloxEngine {
+	public:
+
+		typedef uint32_t result_type;
+
+		static const uint64_t DefaultSeed = 5489;
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return 0xFFFFFFFF; }
+
+		/*! \brief Starts at step 0 of the specified stream. */
+		PhiloxEngine( uint64_t _seed = DefaultSeed, uint64_t _stream = 0 );
+
+		/*! \brief Restarts at step 0 of the specified stream. */
+		void SetSeed( uint64_t _seed, uint64_t _stream = 0 );
+
+		uint64_t GetSeed() const;
+		uint64_t GetStream() const;
+
+		/*! \brief Moves to the start of the specified step, discarding any words
+		 * left over from the current one. */
+		void Seek( uint64_t step );
+
+		/*! \brief Returns the first step whose words have not been drawn. */
+		uint64_t GetStep() const;
+
+		result_type operator()() {
+			if( bufferIndex == 4 ) {
+				GenerateBlock( seed, stream, step++, buffer );
+				bufferIndex = 0;
+			}
+			return buffer[bufferIndex++];
+		}
+
+		/*! \brief Draws a double in [0,1) with 53 random bits. */
+		double Uniform();
+
+		/*! \brief Returns the double in [0,1) made from the specified step of this
+		 * stream, without moving the generator. Safe to call concurrently. */
+		double UniformAt( uint64_t _step ) const;
+
+		/*! \brief Writes the next numBlocks steps to out, four words each, and
+		 * moves past them. Words left over from the current step are discarded.
+		 * Much faster per word than operator() for large batches. */
+		void Generate( std::size_t numBlocks, result_type* out );
+
+		/*! \brief Computes the four words at the specified address. */
+		static void GenerateBlock( uint64_t _seed, uint64_t _stream, uint64_t _step,
+								   result_type* out );
+
+		/*! \brief Makes a double in [0,1) from 53 bits of two words. */
+		static double ToUniform( result_type high, result_type low ) {
+			// 27 high bits and 26 low bits fill the mantissa
+			uint64_t bits = ( (uint64_t) (high >> 5) << 26 ) | (low >> 6);
+			return bits*( 1.0/9007199254740992.0 );
+		}
+
+	private:
+
+		uint64_t seed;
+		uint64_t stream;
+		uint64_t step;
+		result_type buffer[4];
+		unsigned int bufferIndex;
+
+	};
+
+	/*! \brief Samples an index in [0, numWeights) in proportion to the
+	 * non-negative weights given a random number in [0,1). Indices of zero weight
+	 * are never returned unless every weight is zero, when the first is. */
+	inline unsigned int SampleCategorical( const double* weights, unsigned int numWeights,
+										   double rng ) {
+		double z = 0;
+		for( unsigned int i = 0; i < numWeights; i++ ) {
+			z += weights[i];
+		}
+
+		// Accumulates the same sum as z, so only rounding of rng*z can run past
+		// the end, in which case the last positive weight is taken
+		double target = rng*z;
+		double acc = 0;
+		unsigned int last = 0;
+		for( unsigned int i = 0; i < numWeights; i++ ) {
+			if( weights[i] > 0 ) {
+				acc += weights[i];
+				last = i;
+				if( target < acc ) {
+					return i;
+				}
+			}
+		}
+		return last;
+	}
+
+	/*! \brief SampleCategorical() over a fixed number of states, for variables
+	 * whose state count is known at compile time. */
+	template <unsigned int N>
+	unsigned int SampleCategorical( const double* weights, double rng ) {
+		return SampleCategorical( weights, N, rng );
+	}
+
+	/*! \brief As SampleCategorical(), but the elements are natural logs of the
+	 * weights. The weights are normalized by log-sum-exp on the stack, so very
+	 * small or large logs do not underflow. If every element is -infinity the
+	 * first index is returned. */
+	template <unsigned int N>
+	unsigned int SampleLogCategorical( const double* logWeights, double rng ) {
+
+		double maxLog = -std::numeric_limits<double>::infinity();
+		for( unsigned int i = 0; i < N; i++ ) {
+			maxLog = std::max( maxLog, logWeights[i] );
+		}
+		if( maxLog == -std::numeric_limits<double>::infinity() ) {
+			return 0;
+		}
+
+		// Shift by the largest log so that the largest weight is exactly 1
+		double weights[N];
+		for( unsigned int i = 0; i < N; i++ ) {
+			weights[i] = std::exp( logWeights[i] - maxLog );
+		}
+		return SampleCategorical<N>( weights, rng );
+	}
+
+	/*! \brief Walker's alias table over N outcomes, for drawing many times from
+	 * one distribution. Building costs O(N) and each draw costs O(1) with a single
+	 * random number in [0,1). The table lives entirely in the object. */
+	template <unsigned int N>
+	class AliasTable {
+	public:
+
+		/*! \brief Builds the table from non-negative weights by Vose's method. */
+		AliasTable( const double* weights ) {
+
+			double z = 0;
+			for( unsigned int i = 0; i < N; i++ ) {
+				z += weights[i];
+			}
+			if( !( z > 0 ) ) {
+				throw std::logic_error( "Alias table weights must have a positive sum." );
+			}
+
+			// Columns below the mean weight are topped up by one above it
+			double scaled[N];
+			unsigned int small[N], large[N];
+			unsigned int numSmall = 0, numLarge = 0;
+			for( unsigned int i = 0; i < N; i++ ) {
+				scaled[i] = weights[i]*N/z;
+				alias[i] = i;
+				if( scaled[i] < 1.0 ) {
+					small[numSmall++] = i;
+				}
+				else {
+					large[numLarge++] = i;
+				}
+			}
+			while( numSmall > 0 && numLarge > 0 ) {
+				unsigned int s = small[--numSmall];
+				unsigned int l = large[numLarge-1];
+				threshold[s] = scaled[s];
+				alias[s] = l;
+				scaled[l] -= 1.0 - scaled[s];
+				if( scaled[l] < 1.0 ) {
+					numLarge--;
+					small[numSmall++] = l;
+				}
+			}
+
+			// Whatever remains is within rounding of the mean
+			while( numLarge > 0 ) {
+				threshold[ large[--numLarge] ] = 1.0;
+			}
+			while( numSmall > 0 ) {
+				threshold[ small[--numSmall] ] = 1.0;
+			}
+		}
+
+		unsigned int Sample( double rng ) const {
+			double position = rng*N;
+			unsigned int column = std::min( (unsigned int) position, N - 1 );
+			return ( position - column < threshold[column] ) ? column : alias[column];
+		}
+
+	private:
+
+		double threshold[N];
+		unsigned int alias[N];
+
+	};
+
 	// Samples an element from a vector in proportion to their values given a
 	// random number in [0,1]
 	unsigned int SampleNumberLine( const std::vector<double>& line, double rng );
+
+	// As SampleNumberLine, but the elements are natural logs of the weights. The
+	// weights are normalized by log-sum-exp, so very small or large logs do not
+	// underflow. If every element is -infinity the first index is returned.
+	unsigned int SampleLogNumberLine( const std::vector<double>& logLine, double rng );
 	
 	template < class Generator, class S = double >
 	class DistributionBase {
@@ -18,14 +227,16 @@ namespace intelligent {
 		DistributionBase() :
 			adapter( engine, generator ) {}
 
-		void SetSeed( unsigned int seed ) {
-			engine.seed( seed );
+		/*! \brief Restarts the distribution at the beginning of the specified
+		 * stream of the seed. */
+		void SetSeed( uint64_t seed, uint64_t stream = 0 ) {
+			engine.SetSeed( seed, stream );
 		}
 		
 	protected:
 
 		typedef S ScalarType;
-		typedef boost::mt19937 RandEngine;
+		typedef PhiloxEngine RandEngine;
 		typedef Generator GeneratorType;
 		typedef boost::variate_generator<RandEngine&, GeneratorType> RandAdapter;
 
@@ -0,0 +1,74 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace intelligent {
+
+	/*! \brief A fixed set of worker threads for fork-join parallel loops. The
+	 * calling thread takes part in each loop, so a pool of N threads starts N-1
+	 * workers. Loops are run one at a time; a loop started from inside one of
+	 * the pool's own tasks runs serially on that thread instead of deadlocking. */
+	class ThreadPool {
+	public:
+
+		typedef std::shared_ptr<ThreadPool> Ptr;
+
+		/*! \brief A task receives the index of the work item to run. */
+		typedef boost::function<void( unsigned int )> Task;
+
+		/*! \brief Creates a pool of the specified number of threads. 0 selects the
+		 * hardware concurrency. */
+		ThreadPool( unsigned int numThreads = 0 );
+
+		~ThreadPool();
+
+		/*! \brief The number of threads that run tasks, including the caller. */
+		unsigned int NumThreads() const;
+
+		/*! \brief Runs task(i) for every i in [0, numTasks) and returns once all
+		 * have finished. Items are handed out dynamically, so their order and
+		 * thread assignment are unspecified. If any task throws, remaining items
+		 * are skipped and the first exception is rethrown here. */
+		void ParallelFor( unsigned int numTasks, const Task& task );
+
+	private:
+
+		boost::thread_group workers;
+		std::vector<boost::thread::id> workerIDs;
+
+		/*! \brief Serializes loops started from different threads. */
+		boost::mutex callMutex;
+
+		/*! \brief Protects everything below. */
+		boost::mutex mutex;
+		boost::condition_variable wakeCondition;
+		boost::condition_variable doneCondition;
+
+		const Task* currentTask;
+		unsigned int numTasks;
+		unsigned int nextTask;
+		unsigned int numActive;
+		unsigned long generation;
+		bool stopping;
+		boost::thread::id runnerID;
+		std::exception_ptr error;
+
+		void WorkerLoop();
+
+		/*! \brief Claims and runs items of the current loop until none remain. */
+		void RunTasks();
+
+		/*! \brief Returns whether the calling thread is running one of this pool's tasks. */
+		bool InTask();
+
+	};
+
+}
+
+#endif
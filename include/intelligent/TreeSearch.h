@@ -3,6 +3,8 @@
 
 #include <queue>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
 
 #include "intelligent/DiscreteAssembly.h"
 #include "intelligent/AssemblySampler.h"
@@ -40,6 +42,10 @@ namespace intelligent {
 		void Zero() {
 			memset( data, 0, xDim*yDim*zDim*sizeof(C) );
 		}
+
+		void Fill( const C& val ) {
+			std::fill( data, data + xDim*yDim*zDim, val );
+		}
 		
 		C& At( unsigned int x, unsigned int y, unsigned int z ) {
  			return data[ z*xDim*yDim + y*xDim + x ];
@@ -83,6 +89,10 @@ namespace intelligent {
 
 		/*! \brief Specify maximum number of successors to keep in the queue. */
 		void SetMaxQueueSize( unsigned int q );
+
+		/*! \brief Seed the successor sampler so that a search can be repeated
+		 * exactly, regardless of the number of sampling threads. */
+		void SetSeed( uint64_t seed );
 		
 		/*! \brief Add a discrete assembly to the search queue. */
 		void Add(DiscreteAssembly::Ptr _da);
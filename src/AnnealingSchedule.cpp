@@ -0,0 +1,88 @@
+#include "intelligent/AnnealingSchedule.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace intelligent {
+
+	// Inverse temperatures must be non-negative, or sampling would favor
+	// low-potential states
+	static void CheckInverseTemperature( double beta ) {
+		if( !( beta >= 0 ) ) {
+			std::stringstream ss;
+			ss << "Inverse temperature " << beta << " is negative.";
+			throw std::logic_error( ss.str() );
+		}
+	}
+
+	GeometricSchedule::GeometricSchedule( double _initialBeta, double _ratio,
+										  double _maxBeta ) :
+		initialBeta( _initialBeta ),
+		ratio( _ratio ),
+		maxBeta( _maxBeta ) {
+
+		CheckInverseTemperature( initialBeta );
+		CheckInverseTemperature( maxBeta );
+		if( !( ratio > 0 ) ) {
+			std::stringstream ss;
+			ss << "Geometric schedule ratio " << ratio << " is not positive.";
+			throw std::logic_error( ss.str() );
+		}
+	}
+
+	double GeometricSchedule::GetInverseTemperature( unsigned int sweep, double lastBeta,
+													 double changeRate ) const {
+		return std::min( maxBeta, initialBeta*std::pow( ratio, (double) sweep ) );
+	}
+
+	LinearSchedule::LinearSchedule( double _initialBeta, double _finalBeta,
+									unsigned int _numSweeps ) :
+		initialBeta( _initialBeta ),
+		finalBeta( _finalBeta ),
+		numSweeps( _numSweeps ) {
+
+		CheckInverseTemperature( initialBeta );
+		CheckInverseTemperature( finalBeta );
+	}
+
+	double LinearSchedule::GetInverseTemperature( unsigned int sweep, double lastBeta,
+												  double changeRate ) const {
+		if( sweep >= numSweeps ) {
+			return finalBeta;
+		}
+		return initialBeta + ( finalBeta - initialBeta )*sweep/numSweeps;
+	}
+
+	AdaptiveSchedule::AdaptiveSchedule( double _initialBeta, double _targetRate,
+										double _gain, double _maxBeta ) :
+		initialBeta( _initialBeta ),
+		targetRate( _targetRate ),
+		gain( _gain ),
+		maxBeta( _maxBeta ) {
+
+		// A multiplicative update could never leave zero
+		if( !( initialBeta > 0 ) ) {
+			std::stringstream ss;
+			ss << "Adaptive schedule initial inverse temperature " << initialBeta
+			   << " is not positive.";
+			throw std::logic_error( ss.str() );
+		}
+		CheckInverseTemperature( maxBeta );
+		if( targetRate < 0 || targetRate > 1 ) {
+			std::stringstream ss;
+			ss << "Adaptive schedule target rate " << targetRate << " is not in [0,1].";
+			throw std::logic_error( ss.str() );
+		}
+	}
+
+	double AdaptiveSchedule::GetInverseTemperature( unsigned int sweep, double lastBeta,
+													double changeRate ) const {
+		if( sweep == 0 ) {
+			return initialBeta;
+		}
+		return std::min( maxBeta, lastBeta*std::exp( gain*( changeRate - targetRate ) ) );
+	}
+
+}
@@ -1,9 +1,12 @@
 #include "intelligent/AssemblyConstructor.h"
+#include "intelligent/PotentialTable.h"
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 
 namespace intelligent {
 
@@ -16,30 +19,73 @@ namespace intelligent {
 	void AssemblySlot::UpdateSlot( DiscreteAssembly& assembly,
 								   const DiscretePoint3& query ) {
 
+		unsigned int potID = assembly.GetField().NumPotentials();
+		GibbsPotential::Ptr pot = CreatePotential( assembly, query, potID );
+		if( pot ) {
+			assembly.GetField().AddPotential( pot );
+		}
+	}
+
+	GibbsPotential::Ptr AssemblySlot::CreatePotential( DiscreteAssembly& assembly,
+													   const DiscretePoint3& query,
+													   unsigned int potID ) const {
+
+		// Reading through a const reference avoids copying a shared lattice
+		const Lattice& lattice = static_cast<const DiscreteAssembly&>( assembly ).GetLattice();
 		std::vector<unsigned int> ids;
-		BOOST_FOREACH( const DiscretePoint3& offset, points ) {
-			
-			try {
-				DiscretePoint3 pos = query + offset;
-				ids.push_back( assembly.GetLattice().GetNodeID( pos ) );
-			}
-			catch ( std::out_of_range e ) {
-				// This means the slot's nodes do not all exist
-				return;
-			}
+		if( !MatchNodes( lattice, query, ids ) ) {
+			// This means the slot's nodes do not all exist
+			return GibbsPotential::Ptr();
 		}
 		
 		// At this point we have all the ordered IDs to construct the potential
-		unsigned int potID = assembly.GetField().NumPotentials();
-		GibbsPotential::Ptr pot = constructor( assembly.GetField(), assembly.GetLattice(),
-											   potID, ids );
-		assembly.GetField().AddPotential( pot );
-		
-		// Also update the corresponding variables with the new potential
-		BOOST_FOREACH( unsigned int varID, ids ) {
-			GibbsVariable::Ptr var = assembly.GetField().GetVariable( varID );
-			var->AddPotential( potID );
+		return constructor( lattice, potID, ids );
+	}
+
+	bool AssemblySlot::MatchNodes( const Lattice& lattice, const DiscretePoint3& query,
+								   std::vector<unsigned int>& ids ) const {
+
+		// Reject queries that put the slot past the lattice bounds before looking
+		// anything up
+		DiscreteBox3 latticeBox = lattice.GetBoundingBox();
+		if( query.x + boundingBox.minX < latticeBox.minX || query.x + boundingBox.maxX > latticeBox.maxX ||
+			query.y + boundingBox.minY < latticeBox.minY || query.y + boundingBox.maxY > latticeBox.maxY ||
+			query.z + boundingBox.minZ < latticeBox.minZ || query.z + boundingBox.maxZ > latticeBox.maxZ ) {
+			return false;
 		}
+
+		ids.resize( points.size() );
+		for( unsigned int i = 0; i < points.size(); i++ ) {
+			if( !lattice.TryGetNodeID( query + points[i], ids[i] ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	GibbsPotential::Ptr AssemblySlot::ConstructPotential( const Lattice& lattice, unsigned int potID,
+														  const std::vector<unsigned int>& ids ) const {
+		return constructor( lattice, potID, ids );
+	}
+
+	DiscreteBox3 AssemblySlot::GetAnchorRange( const DiscreteBox3& latticeBox ) const {
+		DiscreteBox3 range;
+		if( latticeBox.minX > latticeBox.maxX ) {
+			return range;
+		}
+		// Anchors themselves stay inside the lattice bounds, so slots whose offsets
+		// exclude the origin match exactly where they would on a full scan
+		range.minX = std::max( latticeBox.minX - boundingBox.minX, latticeBox.minX );
+		range.maxX = std::min( latticeBox.maxX - boundingBox.maxX, latticeBox.maxX );
+		range.minY = std::max( latticeBox.minY - boundingBox.minY, latticeBox.minY );
+		range.maxY = std::min( latticeBox.maxY - boundingBox.maxY, latticeBox.maxY );
+		range.minZ = std::max( latticeBox.minZ - boundingBox.minZ, latticeBox.minZ );
+		range.maxZ = std::min( latticeBox.maxZ - boundingBox.maxZ, latticeBox.maxZ );
+		return range;
+	}
+
+	bool AssemblySlot::IsUnary() const {
+		return points.size() == 1;
 	}
 
 // 	bool AssemblySlot::InClique( const DiscretePoint3& base, const DiscretePoint3& query ) const {
@@ -54,32 +100,258 @@ namespace intelligent {
 // 	}
 
 	AssemblyConstructor::AssemblyConstructor( VariableConstructor _constructor ) :
-		constructor( _constructor ) {}
+		constructor( _constructor ),
+		tableLimit( 0 ),
+		fuseUnary( false ),
+		ordering( ORDER_LEXICOGRAPHIC ) {}
+
+	const unsigned int AssemblyConstructor::BricksPerThread;
 
 	void AssemblyConstructor::AddSlot( const AssemblySlot::Ptr& slot ) {
 		slots.push_back( slot );
 	}
 
+	void AssemblyConstructor::AddGlobalSlot( const AssemblySlot::PotentialConstructor& constructor ) {
+		globalSlots.push_back( constructor );
+	}
+
 	void AssemblyConstructor::AddVoxel( DiscreteAssembly& assembly,
 										const DiscretePoint3& pos ) {
 		unsigned int nodeID = assembly.GetField().NumVariables();
-		GibbsVariable::Ptr var = constructor( assembly.GetField(), nodeID );
+		GibbsVariable::Ptr var = constructor( nodeID );
 		assembly.GetField().AddVariable( var );
 
 		assembly.GetLattice().AddNode( nodeID, pos );
 
 	}
 
+	void AssemblyConstructor::AddVoxels( DiscreteAssembly& assembly,
+										 const DiscreteBox3& box ) {
+
+		assembly.GetLattice().Reserve( box );
+		DiscreteBox3::Operator addOp =
+			boost::bind( &AssemblyConstructor::AddVoxel, this, boost::ref(assembly), _1 );
+		Iterate( box, addOp );
+	}
+
+	void AssemblyConstructor::SetVoxelOrdering( VoxelOrdering _ordering ) {
+		ordering = _ordering;
+	}
+
+	void AssemblyConstructor::Iterate( const DiscreteBox3& box,
+									   const DiscreteBox3::Operator& op ) const {
+		if( ordering == ORDER_MORTON ) {
+			box.IterateMorton( op );
+		}
+		else {
+			box.Iterate( op );
+		}
+	}
+
+	std::vector<DiscretePoint3> AssemblyConstructor::ListAnchors( const AssemblySlot& slot,
+																  const Lattice& lattice ) const {
+		std::vector<DiscretePoint3> anchors;
+		DiscreteBox3::Operator pushOp = [&anchors]( const DiscretePoint3& pos ) {
+			anchors.push_back( pos );
+		};
+		Iterate( slot.GetAnchorRange( lattice.GetBoundingBox() ), pushOp );
+		return anchors;
+	}
+
+	unsigned int AssemblyConstructor::NumBricks( std::size_t numAnchors ) const {
+		if( !pool ) {
+			return 1;
+		}
+		return std::max<std::size_t>( std::min<std::size_t>( numAnchors,
+															 pool->NumThreads()*BricksPerThread ), 1 );
+	}
+
+	void AssemblyConstructor::RunBricks( unsigned int numBricks, const ThreadPool::Task& task ) const {
+		if( pool ) {
+			pool->ParallelFor( numBricks, task );
+		}
+		else {
+			for( unsigned int b = 0; b < numBricks; b++ ) {
+				task( b );
+			}
+		}
+	}
+
+	void AssemblyConstructor::BuildSlotPotentials( DiscreteAssembly& assembly,
+												   const AssemblySlot& slot ) {
+
+		GibbsField& field = assembly.GetField();
+		const Lattice& lattice = static_cast<const DiscreteAssembly&>( assembly ).GetLattice();
+		const std::vector<DiscretePoint3> anchors = ListAnchors( slot, lattice );
+		const std::size_t numAnchors = anchors.size();
+		const unsigned int numBricks = NumBricks( numAnchors );
+
+		// Flag the anchors where the slot matches and count them per brick
+		std::vector<unsigned char> matched( numAnchors, 0 );
+		std::vector<unsigned int> firstIDs( numBricks + 1, 0 );
+		ThreadPool::Task matchBrick = [&]( unsigned int b ) {
+			std::vector<unsigned int> ids;
+			unsigned int count = 0;
+			for( std::size_t i = b*numAnchors/numBricks; i < (b+1)*numAnchors/numBricks; i++ ) {
+				if( slot.MatchNodes( lattice, anchors[i], ids ) ) {
+					matched[i] = 1;
+					count++;
+				}
+			}
+			firstIDs[b+1] = count;
+		};
+		RunBricks( numBricks, matchBrick );
+
+		// A prefix sum over the counts gives each brick's first potential ID, so
+		// IDs follow the voxel ordering no matter which thread built what
+		firstIDs[0] = field.NumPotentials();
+		for( unsigned int b = 0; b < numBricks; b++ ) {
+			firstIDs[b+1] += firstIDs[b];
+		}
+
+		std::vector<GibbsPotential::Ptr> pots( firstIDs[numBricks] - firstIDs[0] );
+		ThreadPool::Task constructBrick = [&]( unsigned int b ) {
+			std::vector<unsigned int> ids;
+			unsigned int potID = firstIDs[b];
+			for( std::size_t i = b*numAnchors/numBricks; i < (b+1)*numAnchors/numBricks; i++ ) {
+				if( !matched[i] ) {
+					continue;
+				}
+				slot.MatchNodes( lattice, anchors[i], ids );
+				pots[ potID - firstIDs[0] ] = slot.ConstructPotential( lattice, potID, ids );
+				potID++;
+			}
+		};
+		RunBricks( numBricks, constructBrick );
+
+		// A constructor returning null shifts the IDs of every later potential, so
+		// those are rebuilt here with the IDs the shift gives them
+		std::vector<unsigned int> ids;
+		std::size_t potIndex = 0;
+		for( std::size_t i = 0; i < numAnchors; i++ ) {
+			if( !matched[i] ) {
+				continue;
+			}
+			GibbsPotential::Ptr& pot = pots[potIndex++];
+			if( pot && pot->id != field.NumPotentials() ) {
+				slot.MatchNodes( lattice, anchors[i], ids );
+				pot = slot.ConstructPotential( lattice, field.NumPotentials(), ids );
+			}
+			if( pot ) {
+				field.AddPotential( pot );
+			}
+		}
+	}
+
 	void AssemblyConstructor::BuildPotentials( DiscreteAssembly& assembly ) {
 
-		DiscreteBox3 range = assembly.GetLattice().GetBoundingBox();
-		
+		std::vector<AssemblySlot::Ptr> unarySlots;
 		BOOST_FOREACH( const AssemblySlot::Ptr& slot, slots ) {
-			DiscreteBox3::Operator updateOp =
-				boost::bind( &AssemblySlot::UpdateSlot, slot.get(), boost::ref(assembly), _1 );
-			
-			range.Iterate( updateOp );
-		}		
+			if( fuseUnary && slot->IsUnary() ) {
+				unarySlots.push_back( slot );
+				continue;
+			}
+			BuildSlotPotentials( assembly, *slot );
+		}
+
+		if( !unarySlots.empty() ) {
+			BuildFusedUnaryPotentials( assembly, unarySlots );
+		}
+
+		if( !globalSlots.empty() ) {
+			const Lattice& lattice = static_cast<const DiscreteAssembly&>( assembly ).GetLattice();
+			std::vector<unsigned int> ids = lattice.GetNodeIDs();
+			BOOST_FOREACH( const AssemblySlot::PotentialConstructor& global, globalSlots ) {
+				GibbsPotential::Ptr pot = global( lattice, assembly.GetField().NumPotentials(), ids );
+				if( pot ) {
+					assembly.GetField().AddPotential( pot );
+				}
+			}
+		}
+
+		if( tableLimit > 0 ) {
+			TabulatePotentials( assembly.GetField(), tableLimit );
+		}
+		assembly.GetField().BuildAdjacency();
+	}
+
+	void AssemblyConstructor::SetTableLimit( std::size_t maxEntries ) {
+		tableLimit = maxEntries;
+	}
+
+	void AssemblyConstructor::SetUnaryFusion( bool enable ) {
+		fuseUnary = enable;
+	}
+
+	void AssemblyConstructor::SetThreadPool( const ThreadPool::Ptr& _pool ) {
+		pool = _pool;
+	}
+
+	void AssemblyConstructor::BuildFusedUnaryPotentials( DiscreteAssembly& assembly,
+														 const std::vector<AssemblySlot::Ptr>& unarySlots ) {
+
+		GibbsField& field = assembly.GetField();
+		const unsigned int numVariables = field.NumVariables();
+
+		// Summed log values per variable, flattened at MaxStates per variable
+		const unsigned int stride = PackedStateArray::MaxStates;
+		std::vector<double> logSums( numVariables*stride, 0.0 );
+		std::vector<unsigned char> hasUnary( numVariables, 0 );
+
+		const Lattice& lattice = static_cast<const DiscreteAssembly&>( assembly ).GetLattice();
+		BOOST_FOREACH( const AssemblySlot::Ptr& slot, unarySlots ) {
+			const std::vector<DiscretePoint3> anchors = ListAnchors( *slot, lattice );
+			const std::size_t numAnchors = anchors.size();
+			const unsigned int numBricks = NumBricks( numAnchors );
+
+			// Each anchor of a unary slot is a different voxel, so bricks never
+			// accumulate into the same sums
+			ThreadPool::Task accumulateBrick = [&]( unsigned int b ) {
+				std::vector<unsigned int> ids;
+				for( std::size_t i = b*numAnchors/numBricks; i < (b+1)*numAnchors/numBricks; i++ ) {
+					if( !slot->MatchNodes( lattice, anchors[i], ids ) ) {
+						continue;
+					}
+					// The potential is only evaluated here, so its ID does not matter
+					GibbsPotential::Ptr pot = slot->ConstructPotential( lattice, 0, ids );
+					if( !pot ) {
+						continue;
+					}
+					IDRange clique = pot->GetCliqueIDs();
+					unsigned int varID = clique[0];
+					unsigned int numStates = field.GetVariableRaw( varID )->NumStates();
+					for( unsigned int s = 0; s < numStates; s++ ) {
+						unsigned char state = s;
+						logSums[ varID*stride + s ] += pot->EvaluateLog( CliqueStates( clique, &state ) );
+					}
+					hasUnary[varID] = 1;
+				}
+			};
+			RunBricks( numBricks, accumulateBrick );
+		}
+
+		// Voxels with identical factors, such as all those far from any obstacle,
+		// share a table
+		std::map<std::vector<double>, PotentialTable::Ptr> tables;
+		std::vector<unsigned int> radices( 1 );
+		std::vector<unsigned int> ids( 1 );
+		for( unsigned int varID = 0; varID < numVariables; varID++ ) {
+			if( !hasUnary[varID] ) {
+				continue;
+			}
+
+			radices[0] = field.GetVariableRaw( varID )->NumStates();
+			std::vector<double> logValues( logSums.begin() + varID*stride,
+										   logSums.begin() + varID*stride + radices[0] );
+			PotentialTable::Ptr& table = tables[logValues];
+			if( !table ) {
+				table = std::make_shared<PotentialTable>( radices, logValues );
+			}
+
+			ids[0] = varID;
+			field.AddPotential( std::make_shared<TabulatedPotential>( field.NumPotentials(),
+																	  ids, table ) );
+		}
 	}
 	
 }
\ No newline at end of file
@@ -5,7 +5,8 @@ namespace intelligent {
 
 	AssemblySampler::AssemblySampler( MCMCSampler& _sampler ) :
 		sampler( _sampler ),
-		baseAssembly( nullptr ) { 
+		baseAssembly( nullptr ),
+		depthInSweeps( false ) { 
 // 			std::cout << "inside AssemblySampler.AssemblySampler, _  " << _sampler.hasIndices << std::endl;
 // 			std::cout << "inside AssemblySampler.AssemblySampler  " << sampler.hasIndices << std::endl;			
 		}
@@ -14,23 +15,71 @@ namespace intelligent {
 		baseAssembly = assembly;
 	}
 
+	void AssemblySampler::SetDepthInSweeps( bool enable ) {
+		depthInSweeps = enable;
+	}
+
+	void AssemblySampler::SetThreadPool( const ThreadPool::Ptr& _pool ) {
+		pool = _pool;
+	}
+
+	void AssemblySampler::SetSeed( uint64_t seed ) {
+		sampler.SetSeed( seed );
+	}
+
 	std::vector<DiscreteAssembly::Ptr> AssemblySampler::Sample( unsigned int numSamples,
 																unsigned int sampleDepth ) {
 
 // 		std::cout << "inside AssemblySampler.SetBase  " << sampler.hasIndices << std::endl;			
 
+		// Build the shared tables once so that the chains do not each copy the
+		// topology to build their own
+		GibbsField& baseField = baseAssembly->GetField();
+		if( !baseField.HasAdjacency() ) {
+			baseField.BuildAdjacency();
+		}
+		if( depthInSweeps && sampler.GetSweepType() == MCMCSampler::SWEEP_CHROMATIC &&
+			!baseField.HasColoring() ) {
+			baseField.BuildColoring();
+		}
 		
-		std::vector<DiscreteAssembly::Ptr> samples( numSamples );
-		for( int i = 0; i < numSamples; i++ ) {
+		// Forking every chain in order from the shared sampler fixes each chain's
+		// stream before any of them run
+		std::vector<MCMCSampler> chainSamplers;
+		chainSamplers.reserve( numSamples );
+		for( unsigned int i = 0; i < numSamples; i++ ) {
+			chainSamplers.push_back( sampler.Fork() );
+		}
 
+		std::vector<DiscreteAssembly::Ptr> samples( numSamples );
+		ThreadPool::Task chainTask = [&]( unsigned int i ) {
 			DiscreteAssembly::Ptr sample =
 				std::make_shared<DiscreteAssembly>( *baseAssembly );
-			sampler.Sample( sample->GetField(), sampleDepth ); // Samplicious
+			RunChain( chainSamplers[i], *sample, sampleDepth );
 			samples[i] = sample;
+		};
+
+		if( pool && numSamples > 1 ) {
+			pool->ParallelFor( numSamples, chainTask );
+		}
+		else {
+			for( unsigned int i = 0; i < numSamples; i++ ) {
+				chainTask( i );
+			}
 		}
 		
 		return samples;
 		
 	}
+
+	void AssemblySampler::RunChain( MCMCSampler& chainSampler, DiscreteAssembly& sample,
+									unsigned int sampleDepth ) const {
+		if( depthInSweeps ) {
+			chainSampler.Sweep( sample.GetField(), sampleDepth );
+		}
+		else {
+			chainSampler.Sample( sample.GetField(), sampleDepth ); // Samplicious
+		}
+	}
 	
-}
\ No newline at end of file
+}
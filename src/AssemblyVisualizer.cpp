@@ -22,11 +22,20 @@ namespace intelligent {
 		
 		requestCounter = 0;
 		
-		DiscreteBox3::Operator visOp =
-			boost::bind( &AssemblyVisualizer::VisualizePoint, this, assembly, boost::ref(requests), _1 );
-		DiscreteBox3 latticeBounds = assembly.GetLattice().GetBoundingBox();
-
-		latticeBounds.Iterate( visOp );
+		// Empty blocks are only drawn as outlines, so skip them when those are off
+		const Lattice& lattice = assembly.GetLattice();
+		const PackedStateArray& states = assembly.GetField().GetStates();
+		auto visOp = [&]( std::size_t id, unsigned char state ) {
+			VisualizeBlock( requests, lattice.GetNodePosition( id ),
+							static_cast<BlockType>( state ) );
+		};
+		if( showOutlines ) {
+			states.ForEach( visOp );
+		}
+		else {
+			states.ForEachNonZero( visOp );
+		}
+		DiscreteBox3 latticeBounds = lattice.GetBoundingBox();
 
 		ArrowRenderRequest areq;
 		areq.start[2] = latticeBounds.minZ - 0.5;
@@ -69,9 +78,8 @@ namespace intelligent {
 		renderer.QueueRenderRequests( requests );
 	}
 
-	void AssemblyVisualizer::VisualizePoint( const DiscreteAssembly& assembly,
-											 std::vector<RenderRequestVariant>& requests,
-											 const DiscretePoint3& point ) {
+	void AssemblyVisualizer::VisualizeBlock( std::vector<RenderRequestVariant>& requests,
+											 const DiscretePoint3& point, BlockType state ) {
 
 		CubeRenderRequest creq;
 		creq.id = requestCounter++;
@@ -87,14 +95,6 @@ namespace intelligent {
 		creq.lengths[1] = 1;
 		creq.lengths[2] = 1;
 
-		unsigned int id = assembly.GetLattice().GetNodeID( point );
-		GibbsVariable::Ptr var = assembly.GetField().GetVariable( id );
-		BlockVariable::Ptr block = std::dynamic_pointer_cast<BlockVariable>( var );
-		if( !block ) {
-			throw std::runtime_error( "Variable was not a BlockVariable!" );
-		}
-
-		BlockType state = block->GetState();
 		switch( state ) {
 			case BLOCK_EMPTY:
 				if( !showOutlines ) { return; }
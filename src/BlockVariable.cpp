@@ -6,54 +6,28 @@
 
 namespace intelligent {
 
-	BlockVariable::BlockVariable( const GibbsField& _field, unsigned int _id ) : GibbsVariable( _field, _id ) {
-		state = BLOCK_EMPTY;
-	}  
-  
-	BlockVariable::BlockVariable( const GibbsField& _field, const BlockVariable& other ) :
-		GibbsVariable( _field, other ) {
-			
-		state = other.state;
-	}
+	BlockVariable::BlockVariable( unsigned int _id ) : GibbsVariable( _id ) {}
 
-	GibbsVariable::Ptr BlockVariable::Clone( const GibbsField& _field ){
-		std::shared_ptr<GibbsVariable> pointer( new BlockVariable( _field, *this ) );
-		return pointer;
+	unsigned int BlockVariable::NumStates() const {
+		return 3;
 	}
-			
-	void BlockVariable::Sample( double rng ){
 
-		std::vector<double> potentials(3);
-		state = BLOCK_EMPTY;
-		potentials[0] = CalculatePotential();
-		state = BLOCK_HALF;
-		potentials[1] = CalculatePotential();
-		state = BLOCK_FULL;
-		potentials[2] = CalculatePotential();
+	unsigned char BlockVariable::SampleState( const GibbsField& field, double rng ) const {
 
-		unsigned int ind = SampleNumberLine( potentials, rng );
-		if( ind == 0 ) {
-			state = BLOCK_EMPTY;
-		}
-		else if( ind == 1 ) {
-			state = BLOCK_HALF;
-		}
-		else if( ind == 2 ) {
-			state = BLOCK_FULL;
-		}
-		else {
-			std::stringstream ss;
-			ss << "Received invalid sample index of " << ind << std::endl;
-			throw std::runtime_error( ss.str() );
-		}
+		// Conditionals are indexed by state, so the sampled index is the new state.
+		// They are drawn in the log domain so that products of many small
+		// potentials do not underflow.
+		double logPotentials[3];
+		CalculateLogConditionals( field, logPotentials );
+		return SampleLogCategorical<3>( logPotentials, rng );
 	}
 
-	void BlockVariable::SetState( BlockType _state ) {
-		state = _state;
+	void BlockVariable::SetState( GibbsField& field, BlockType _state ) const {
+		field.SetState( id, _state );
 	}
 	
-	BlockType BlockVariable::GetState() const {
-		return state;
+	BlockType BlockVariable::GetState( const GibbsField& field ) const {
+		return GetBlockState( field, id );
 	}
 			
 }
@@ -0,0 +1,279 @@
+#include "intelligent/ChainSampler.h"
+#include "intelligent/RandomDistributions.h"
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace intelligent {
+
+	static const double NegativeInfinity = -std::numeric_limits<double>::infinity();
+
+	/*! \brief Returns log( sum( exp( values ) ) ) without overflow. */
+	static double LogSumExp( const double* values, unsigned int numValues ) {
+		double maxValue = NegativeInfinity;
+		for( unsigned int i = 0; i < numValues; i++ ) {
+			maxValue = std::max( maxValue, values[i] );
+		}
+		if( maxValue == NegativeInfinity ) {
+			return NegativeInfinity;
+		}
+		double sum = 0;
+		for( unsigned int i = 0; i < numValues; i++ ) {
+			sum += std::exp( values[i] - maxValue );
+		}
+		return maxValue + std::log( sum );
+	}
+
+	/*! \brief Samples an index in proportion to the exponentials of the logs,
+	 * using the caller's scratch for the weights. */
+	static unsigned int SampleLogs( const double* logs, unsigned int numLogs, double rng,
+									double* weights ) {
+		double maxLog = NegativeInfinity;
+		for( unsigned int i = 0; i < numLogs; i++ ) {
+			maxLog = std::max( maxLog, logs[i] );
+		}
+		for( unsigned int i = 0; i < numLogs; i++ ) {
+			weights[i] = ( maxLog == NegativeInfinity ) ? 0 : std::exp( logs[i] - maxLog );
+		}
+		return SampleCategorical( weights, numLogs, rng );
+	}
+
+	ChainSampler::ChainSampler( const GibbsField& field,
+								const std::vector<unsigned int>& _chain ) :
+		chain( _chain ),
+		order( 0 ),
+		maxRadix( 1 ) {
+
+		if( chain.empty() ) {
+			throw std::logic_error( "Cannot sample an empty chain." );
+		}
+
+		std::vector<int> positions( field.NumVariables(), -1 );
+		for( unsigned int i = 0; i < chain.size(); i++ ) {
+			if( positions[ chain[i] ] >= 0 ) {
+				std::stringstream ss;
+				ss << "Variable " << chain[i] << " appears twice in a chain.";
+				throw std::logic_error( ss.str() );
+			}
+			positions[ chain[i] ] = i;
+			radices.push_back( field.GetVariableRaw( chain[i] )->NumStates() );
+			maxRadix = std::max( maxRadix, radices.back() );
+		}
+
+		// Every potential touching the chain is assigned to the last position it
+		// touches, once, however many chain variables it contains
+		typedef std::pair<unsigned int, unsigned int> Assignment;
+		std::vector<Assignment> assignments;
+		BOOST_FOREACH( unsigned int varID, chain ) {
+			BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( varID ) ) {
+				int first = chain.size();
+				int last = -1;
+				BOOST_FOREACH( unsigned int memberID, field.GetPotentialAdjacency( potID ) ) {
+					if( positions[memberID] >= 0 ) {
+						first = std::min( first, positions[memberID] );
+						last = std::max( last, positions[memberID] );
+					}
+				}
+				if( last - first > (int) MaxOrder ) {
+					std::stringstream ss;
+					ss << "Potential " << potID << " couples chain positions " << first
+					   << " and " << last << ", more than " << MaxOrder << " apart.";
+					throw std::runtime_error( ss.str() );
+				}
+				order = std::max( order, (unsigned int) ( last - first ) );
+				assignments.push_back( Assignment( last, potID ) );
+			}
+		}
+		std::sort( assignments.begin(), assignments.end() );
+		assignments.erase( std::unique( assignments.begin(), assignments.end() ),
+						   assignments.end() );
+
+		factorOffsets.assign( chain.size() + 1, 0 );
+		memberOffsets.push_back( 0 );
+		BOOST_FOREACH( const Assignment& assignment, assignments ) {
+			factorOffsets[ assignment.first + 1 ]++;
+			factorPotentials.push_back( assignment.second );
+			BOOST_FOREACH( unsigned int memberID, field.GetPotentialAdjacency( assignment.second ) ) {
+				int position = positions[memberID];
+				memberLags.push_back( position >= 0 ? (int) assignment.first - position : -1 );
+			}
+			memberOffsets.push_back( memberLags.size() );
+		}
+		for( unsigned int i = 0; i < chain.size(); i++ ) {
+			factorOffsets[i+1] += factorOffsets[i];
+		}
+	}
+
+	unsigned int ChainSampler::GetOrder() const {
+		return order;
+	}
+
+	const std::vector<unsigned int>& ChainSampler::GetChain() const {
+		return chain;
+	}
+
+	void ChainSampler::Draw( const GibbsField& field, double beta, const double* uniforms,
+							 unsigned char* out, Workspace& workspace ) const {
+
+		// Tuples cover positions i-order..i with the first varying fastest. Each
+		// position's factors and messages get a slot big enough for any tuple.
+		std::size_t messageSlot = 1;
+		for( unsigned int j = 0; j < order; j++ ) {
+			messageSlot *= maxRadix;
+		}
+		std::size_t factorSlot = messageSlot*maxRadix;
+		workspace.logFactors.resize( factorSlot*chain.size() );
+		workspace.logMessages.resize( messageSlot*chain.size() );
+
+		const int n = chain.size();
+		const double startMessage = 0;
+		unsigned char digits[MaxOrder+1];
+		double logs[PackedStateArray::MaxStates];
+		double factorValues[ PackedStateArray::MaxStates*PackedStateArray::MaxStates*
+							 PackedStateArray::MaxStates*PackedStateArray::MaxStates ];
+		for( int i = 0; i < n; i++ ) {
+
+			std::size_t numTuples = 1;
+			for( unsigned int j = 0; j <= order; j++ ) {
+				numTuples *= GetRadix( i - order + j );
+			}
+			const unsigned int firstRadix = GetRadix( i - order );
+			const std::size_t numPrefixes = numTuples / GetRadix( i );
+
+			// Sum the log of every factor assigned here over the tuples. Members
+			// outside the chain keep their field states throughout.
+			double* logFactors = &workspace.logFactors[ i*factorSlot ];
+			std::fill( logFactors, logFactors + numTuples, 0.0 );
+			for( unsigned int f = factorOffsets[i]; f < factorOffsets[i+1]; f++ ) {
+
+				const GibbsPotential* potential = field.GetPotentialRaw( factorPotentials[f] );
+				IDRange clique = potential->GetCliqueIDs();
+				const int* lags = &memberLags[ memberOffsets[f] ];
+				workspace.cliqueStates.resize( clique.size() );
+				for( unsigned int m = 0; m < clique.size(); m++ ) {
+					if( lags[m] < 0 ) {
+						workspace.cliqueStates[m] = field.GetState( clique[m] );
+					}
+				}
+
+				// Most factors touch only some tuple positions, so each is evaluated
+				// once per assignment of those and the value reused across the rest
+				bool used[MaxOrder+1] = { false };
+				for( unsigned int m = 0; m < clique.size(); m++ ) {
+					if( lags[m] >= 0 ) {
+						used[ order - lags[m] ] = true;
+					}
+				}
+
+				std::fill( digits, digits + order + 1, 0 );
+				for( std::size_t t = 0; t < numTuples; t++ ) {
+
+					std::size_t key = 0;
+					std::size_t keyStride = 1;
+					bool first = true;
+					for( unsigned int j = 0; j <= order; j++ ) {
+						if( used[j] ) {
+							key += digits[j]*keyStride;
+							keyStride *= GetRadix( i - order + j );
+						}
+						else if( digits[j] != 0 ) {
+							first = false;
+						}
+					}
+
+					if( first ) {
+						for( unsigned int m = 0; m < clique.size(); m++ ) {
+							if( lags[m] >= 0 ) {
+								workspace.cliqueStates[m] = digits[ order - lags[m] ];
+							}
+						}
+						factorValues[key] = potential->EvaluateLog(
+							CliqueStates( clique, workspace.cliqueStates.data() ) );
+					}
+					logFactors[t] += factorValues[key];
+
+					for( unsigned int j = 0; j <= order; j++ ) {
+						if( ++digits[j] < GetRadix( i - order + j ) ) {
+							break;
+						}
+						digits[j] = 0;
+					}
+				}
+			}
+
+			// Zero potentials stay impossible at any temperature, including beta = 0
+			for( std::size_t t = 0; t < numTuples; t++ ) {
+				if( logFactors[t] != NegativeInfinity ) {
+					logFactors[t] *= beta;
+				}
+			}
+
+			// Sum out the first position of each tuple to get the message over the
+			// rest, normalized so that its largest entry is 0
+			const double* previous = ( i == 0 ) ? &startMessage :
+				&workspace.logMessages[ (i-1)*messageSlot ];
+			double* message = &workspace.logMessages[ i*messageSlot ];
+			double maxMessage = NegativeInfinity;
+			for( std::size_t s = 0; s < numTuples/firstRadix; s++ ) {
+				for( unsigned int d = 0; d < firstRadix; d++ ) {
+					std::size_t t = d + firstRadix*s;
+					logs[d] = previous[ t % numPrefixes ] + logFactors[t];
+				}
+				message[s] = LogSumExp( logs, firstRadix );
+				maxMessage = std::max( maxMessage, message[s] );
+			}
+			if( maxMessage != NegativeInfinity ) {
+				for( std::size_t s = 0; s < numTuples/firstRadix; s++ ) {
+					message[s] -= maxMessage;
+				}
+			}
+		}
+
+		// Draw the last order positions together from the final message
+		double weights[ PackedStateArray::MaxStates*PackedStateArray::MaxStates*
+						PackedStateArray::MaxStates ];
+		if( order > 0 ) {
+			std::size_t numSuffixes = 1;
+			for( int p = n - order; p < n; p++ ) {
+				numSuffixes *= GetRadix( p );
+			}
+			std::size_t index = SampleLogs( &workspace.logMessages[ (n-1)*messageSlot ],
+											numSuffixes, uniforms[n], weights );
+			for( int p = n - order; p < n; p++ ) {
+				if( p >= 0 ) {
+					out[p] = index % GetRadix( p );
+				}
+				index /= GetRadix( p );
+			}
+		}
+
+		// Then walk back, drawing each earlier position given the ones after it
+		for( int i = n - 1; i >= (int) order; i-- ) {
+
+			const int p = i - order;
+			const unsigned int firstRadix = GetRadix( p );
+			std::size_t suffix = 0;
+			std::size_t numTuples = firstRadix;
+			for( int q = p + 1; q <= i; q++ ) {
+				suffix += out[q]*( numTuples/firstRadix );
+				numTuples *= GetRadix( q );
+			}
+			const std::size_t numPrefixes = numTuples / GetRadix( i );
+
+			const double* previous = ( i == 0 ) ? &startMessage :
+				&workspace.logMessages[ (i-1)*messageSlot ];
+			const double* logFactors = &workspace.logFactors[ i*factorSlot ];
+			for( unsigned int d = 0; d < firstRadix; d++ ) {
+				std::size_t t = d + firstRadix*suffix;
+				logs[d] = previous[ t % numPrefixes ] + logFactors[t];
+			}
+			out[p] = SampleLogs( logs, firstRadix, uniforms[p], weights );
+		}
+	}
+
+}
@@ -2,7 +2,8 @@
 
 namespace intelligent {
 
-	DiscreteAssembly::DiscreteAssembly() {}
+	DiscreteAssembly::DiscreteAssembly() :
+		lattice( std::make_shared<Lattice>() ) {}
 
 	DiscreteAssembly::DiscreteAssembly( const DiscreteAssembly& other ) :
 		field( other.field ),
@@ -17,16 +18,27 @@ namespace intelligent {
 	}
 
 	Lattice& DiscreteAssembly::GetLattice() {
-		return lattice;
+		if( lattice.use_count() > 1 ) {
+			lattice = std::make_shared<Lattice>( *lattice );
+		}
+		return *lattice;
 	}
 
 	const Lattice& DiscreteAssembly::GetLattice() const {
-		return lattice;
+		return *lattice;
 	}
 	
 	BlockVariable::Ptr DiscreteAssembly::GetBlock( unsigned int id ) const {
 		GibbsVariable::Ptr var = field.GetVariable( id );
 		return std::dynamic_pointer_cast<BlockVariable>( var );
 	}
+
+	BlockType DiscreteAssembly::GetBlockState( unsigned int id ) const {
+		return intelligent::GetBlockState( field, id );
+	}
+
+	void DiscreteAssembly::SetBlockState( unsigned int id, BlockType state ) {
+		field.SetState( id, state );
+	}
 	
 }
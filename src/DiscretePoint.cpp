@@ -2,6 +2,7 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 namespace intelligent {
@@ -136,4 +137,48 @@ namespace intelligent {
 		}
 	}
 
+	namespace {
+
+		/*! \brief Visits the points of the box within the cube of the specified
+		 * corner and power-of-two size, recursing into octants in Morton order. */
+		void IterateMortonCube( const DiscreteBox3& box, long long x, long long y, long long z,
+								long long size, const DiscreteBox3::Operator& op ) {
+
+			if( x > box.maxX || x + size - 1 < box.minX ||
+				y > box.maxY || y + size - 1 < box.minY ||
+				z > box.maxZ || z + size - 1 < box.minZ ) {
+				return;
+			}
+			if( size == 1 ) {
+				op( DiscretePoint3( x, y, z ) );
+				return;
+			}
+
+			long long half = size/2;
+			for( unsigned int octant = 0; octant < 8; octant++ ) {
+				IterateMortonCube( box,
+								   x + ( (octant >> 2) & 1 )*half,
+								   y + ( (octant >> 1) & 1 )*half,
+								   z + ( octant & 1 )*half,
+								   half, op );
+			}
+		}
+
+	}
+
+	void DiscreteBox3::IterateMorton( Operator op ) const {
+
+		if( minX > maxX || minY > maxY || minZ > maxZ ) {
+			return;
+		}
+
+		long long extent = std::max( (long long) maxX - minX,
+									 std::max( (long long) maxY - minY, (long long) maxZ - minZ ) ) + 1;
+		long long size = 1;
+		while( size < extent ) {
+			size *= 2;
+		}
+		IterateMortonCube( *this, minX, minY, minZ, size, op );
+	}
+
 }
@@ -6,141 +6,607 @@
 #include <sstream>
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 namespace intelligent {
-	
-	GibbsPotential::GibbsPotential( const GibbsField& _field, unsigned int _id,
+
+	CliqueStates::CliqueStates( const GibbsField& _field, IDRange _ids ) :
+		field( &_field ),
+		ids( _ids ),
+		values( nullptr ),
+		candidateID( NoCandidate ),
+		candidateState( 0 ) {}
+
+	CliqueStates::CliqueStates( const GibbsField& _field, IDRange _ids,
+								unsigned int _candidateID, unsigned char _candidateState ) :
+		field( &_field ),
+		ids( _ids ),
+		values( nullptr ),
+		candidateID( _candidateID ),
+		candidateState( _candidateState ) {}
+
+	CliqueStates::CliqueStates( IDRange _ids, const unsigned char* _values ) :
+		field( nullptr ),
+		ids( _ids ),
+		values( _values ),
+		candidateID( NoCandidate ),
+		candidateState( 0 ) {}
+
+	GibbsPotential::GibbsPotential( unsigned int _id,
 									const std::vector<unsigned int>& _variableIDs ) :
-		field( _field ),
 		id( _id ),
 		variableIDs( _variableIDs ) {}
 
-	GibbsPotential::GibbsPotential( const GibbsField& _field,
-									const GibbsPotential& other ) :
-		field( _field ),
-		id( other.id ),
-		variableIDs( other.variableIDs ) {}
+	GibbsPotential::~GibbsPotential() {}
 
-	std::vector<GibbsVariable::Ptr> GibbsPotential::GetClique() const {
-		
-		std::vector<GibbsVariable::Ptr> clique;
-		BOOST_FOREACH( unsigned int varID, variableIDs ) {
-			clique.push_back( field.GetVariable( varID ) );
+	IDRange GibbsPotential::GetCliqueIDs() const {
+		return IDRange( variableIDs.data(), variableIDs.data() + variableIDs.size() );
+	}
+
+	double GibbsPotential::CalculatePotential( const GibbsField& field ) const {
+		const double* stats = FindStatistics( field );
+		if( stats ) {
+			return EvaluateStatistics( stats );
 		}
-		return clique;
+		return Evaluate( CliqueStates( field, GetCliqueIDs() ) );
 	}
-		
-	GibbsVariable::GibbsVariable( const GibbsField& _field, unsigned int _id ) :
-		field( _field ),
+
+	double GibbsPotential::CalculatePotential( const GibbsField& field, unsigned int varID,
+											   unsigned char candidate ) const {
+		const double* stats = FindStatistics( field );
+		if( stats ) {
+			double candidateStats[ MaxStatistics ];
+			ComputeCandidateStatistics( field, stats, varID, candidate, candidateStats );
+			return EvaluateStatistics( candidateStats );
+		}
+		return Evaluate( CliqueStates( field, GetCliqueIDs(), varID, candidate ) );
+	}
+
+	void GibbsPotential::CalculateCandidatePotentials( const GibbsField& field, unsigned int varID,
+													   unsigned int numStates, double* out ) const {
+		EvaluateCandidates( field, varID, numStates, false, out );
+	}
+
+	double GibbsPotential::CalculateLogPotential( const GibbsField& field ) const {
+		const double* stats = FindStatistics( field );
+		if( stats ) {
+			return EvaluateLogStatistics( stats );
+		}
+		return EvaluateLog( CliqueStates( field, GetCliqueIDs() ) );
+	}
+
+	double GibbsPotential::CalculateLogPotential( const GibbsField& field, unsigned int varID,
+												  unsigned char candidate ) const {
+		const double* stats = FindStatistics( field );
+		if( stats ) {
+			double candidateStats[ MaxStatistics ];
+			ComputeCandidateStatistics( field, stats, varID, candidate, candidateStats );
+			return EvaluateLogStatistics( candidateStats );
+		}
+		return EvaluateLog( CliqueStates( field, GetCliqueIDs(), varID, candidate ) );
+	}
+
+	void GibbsPotential::CalculateCandidateLogPotentials( const GibbsField& field, unsigned int varID,
+														  unsigned int numStates, double* out ) const {
+		EvaluateCandidates( field, varID, numStates, true, out );
+	}
+
+	double GibbsPotential::EvaluateLog( const CliqueStates& states ) const {
+		return std::log( Evaluate( states ) );
+	}
+
+	bool GibbsPotential::IsEquivalent( const GibbsPotential& other ) const {
+		return false;
+	}
+
+	unsigned int GibbsPotential::NumStatistics() const {
+		return 0;
+	}
+
+	void GibbsPotential::InitializeStatistics( const CliqueStates& states, double* stats ) const {}
+
+	void GibbsPotential::UpdateStatistics( std::size_t cliqueIndex, unsigned char oldState,
+										   unsigned char newState, double* stats ) const {}
+
+	double GibbsPotential::EvaluateStatistics( const double* stats ) const {
+		throw std::logic_error( "Potential does not keep statistics." );
+	}
+
+	double GibbsPotential::EvaluateLogStatistics( const double* stats ) const {
+		return std::log( EvaluateStatistics( stats ) );
+	}
+
+	const double* GibbsPotential::FindStatistics( const GibbsField& field ) const {
+		// Only use statistics the field keeps for this very potential
+		if( id >= field.NumPotentials() || field.GetPotentialRaw( id ) != this ) {
+			return nullptr;
+		}
+		return field.GetStatistics( id );
+	}
+
+	void GibbsPotential::ComputeCandidateStatistics( const GibbsField& field, const double* stats,
+													 unsigned int varID, unsigned char candidate,
+													 double* candidateStats ) const {
+
+		std::copy( stats, stats + NumStatistics(), candidateStats );
+
+		const unsigned char current = field.GetState( varID );
+		IDRange potIDs = field.GetVariableAdjacency( varID );
+		IDRange positions = field.GetVariableAdjacencyPositions( varID );
+		for( unsigned int k = 0; k < potIDs.size(); k++ ) {
+			if( potIDs[k] == id ) {
+				UpdateStatistics( positions[k], current, candidate, candidateStats );
+			}
+		}
+	}
+
+	void GibbsPotential::EvaluateCandidates( const GibbsField& field, unsigned int varID,
+											 unsigned int numStates, bool useLog, double* out ) const {
+
+		const double* stats = FindStatistics( field );
+		if( stats ) {
+			double candidateStats[ MaxStatistics ];
+			for( unsigned int s = 0; s < numStates; s++ ) {
+				ComputeCandidateStatistics( field, stats, varID, s, candidateStats );
+				out[s] = useLog ? EvaluateLogStatistics( candidateStats )
+								: EvaluateStatistics( candidateStats );
+			}
+			return;
+		}
+
+		IDRange clique = GetCliqueIDs();
+		if( clique.size() > MaxGatheredClique ) {
+			for( unsigned int s = 0; s < numStates; s++ ) {
+				CliqueStates view( field, clique, varID, s );
+				out[s] = useLog ? EvaluateLog( view ) : Evaluate( view );
+			}
+			return;
+		}
+
+		// Gather the clique once, then vary the candidate's slots in place
+		unsigned char gathered[ MaxGatheredClique ];
+		unsigned int slots[ MaxGatheredClique ];
+		unsigned int numSlots = 0;
+		for( unsigned int i = 0; i < clique.size(); i++ ) {
+			gathered[i] = field.GetState( clique[i] );
+			if( clique[i] == varID ) {
+				slots[ numSlots++ ] = i;
+			}
+		}
+
+		CliqueStates view( clique, gathered );
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			for( unsigned int j = 0; j < numSlots; j++ ) {
+				gathered[ slots[j] ] = s;
+			}
+			out[s] = useLog ? EvaluateLog( view ) : Evaluate( view );
+		}
+	}
+
+	GibbsVariable::GibbsVariable( unsigned int _id ) :
 		id( _id ) {}
 
-	GibbsVariable::GibbsVariable( const GibbsField& _field, const GibbsVariable& other ) :
-		field( _field ),
-		id( other.id ),
-		potentialIDs( other.potentialIDs ) {}
+	GibbsVariable::~GibbsVariable() {}
 
-	double GibbsVariable::CalculatePotential() {
+	double GibbsVariable::CalculatePotential( const GibbsField& field ) const {
+
+		field.RequireAdjacency();
 
 		double prod = 1.0;
-		std::vector <GibbsPotential::Ptr> potentials = GetPotentials();
-		BOOST_FOREACH( const GibbsPotential::Ptr& pot, potentials ) {
-			prod *= pot->CalculatePotential();
+		BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( id ) ) {
+			prod *= field.GetPotentialRaw( potID )->CalculatePotential( field );
 		}
 
 		return prod;
 	}
 
-	std::vector<GibbsPotential::Ptr> GibbsVariable::GetPotentials() const {
-		
-		std::vector<GibbsPotential::Ptr> potentials;
-		BOOST_FOREACH( unsigned int potID, potentialIDs ) {
-			potentials.push_back( field.GetPotential( potID ) );
+	void GibbsVariable::CalculateConditionals( const GibbsField& field, double* out ) const {
+
+		field.RequireAdjacency();
+
+		const unsigned int numStates = NumStates();
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			out[s] = 1.0;
+		}
+
+		double candidates[ PackedStateArray::MaxStates ];
+		BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( id ) ) {
+			field.GetPotentialRaw( potID )->CalculateCandidatePotentials( field, id, numStates,
+																		  candidates );
+			for( unsigned int s = 0; s < numStates; s++ ) {
+				out[s] *= candidates[s];
+			}
 		}
-		return potentials;
 	}
 
-	void GibbsVariable::AddPotential( unsigned int potID ) {
-		potentialIDs.push_back( potID );
+	double GibbsVariable::CalculateLogPotential( const GibbsField& field ) const {
+
+		field.RequireAdjacency();
+
+		double sum = 0.0;
+		BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( id ) ) {
+			sum += field.GetPotentialRaw( potID )->CalculateLogPotential( field );
+		}
+
+		return sum;
 	}
-		
-	GibbsField::GibbsField() {}
 
-	GibbsField::GibbsField( const GibbsField& other ) {
+	void GibbsVariable::CalculateLogConditionals( const GibbsField& field, double* out ) const {
 
-		BOOST_FOREACH( const VariableMap::value_type& item, other.variables ) {
-			GibbsVariable::Ptr var = item.second->Clone( *this );
-			AddVariable( var );
+		field.RequireAdjacency();
+
+		const unsigned int numStates = NumStates();
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			out[s] = 0.0;
 		}
 
-		BOOST_FOREACH( const PotentialMap::value_type& item, other.potentials ) {
-			GibbsPotential::Ptr pot = item.second->Clone( *this );
-			AddPotential( pot );
+		double candidates[ PackedStateArray::MaxStates ];
+		BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( id ) ) {
+			field.GetPotentialRaw( potID )->CalculateCandidateLogPotentials( field, id, numStates,
+																			 candidates );
+			for( unsigned int s = 0; s < numStates; s++ ) {
+				out[s] += candidates[s];
+			}
 		}
-		
+	}
+
+	void GibbsVariable::Sample( GibbsField& field, double rng ) const {
+		field.RequireAdjacency();
+		field.SetState( id, SampleState( field, rng ) );
+	}
+
+	GibbsField::Topology::Topology() :
+		adjacencyValid( false ),
+		statisticOffsets( 1, 0 ),
+		coloringValid( false ),
+		numColors( 0 ) {}
+
+	GibbsField::GibbsField() :
+		topology( std::make_shared<Topology>() ),
+		trackLogPotential( false ),
+		finiteLogSum( 0 ),
+		numZeroPotentials( 0 ) {}
+
+	GibbsField::Topology& GibbsField::MutableTopology() {
+		if( topology.use_count() > 1 ) {
+			topology = std::make_shared<Topology>( *topology );
+		}
+		return *topology;
 	}
 
 	void GibbsField::AddVariable( const GibbsVariable::Ptr& var ) {
-		
-		if( variables.count( var->id ) > 0 ) {
+
+		Topology& t = MutableTopology();
+		if( var->id != t.variables.size() ) {
 			std::stringstream ss;
-			ss << "Field already has variable with id " << var->id;
+			ss << "Field expected variable with id " << t.variables.size()
+			   << " but received id " << var->id;
 			throw std::runtime_error( ss.str() );
 		}
-		variables[ var->id ] = var;
+		if( var->NumStates() > PackedStateArray::MaxStates ) {
+			std::stringstream ss;
+			ss << "Variable " << var->id << " has " << var->NumStates()
+			   << " states but the field stores at most " << PackedStateArray::MaxStates;
+			throw std::runtime_error( ss.str() );
+		}
+		t.variables.push_back( var );
+		t.adjacencyValid = false;
+		t.coloringValid = false;
+		states.push_back( 0 );
 	}
 
 	void GibbsField::AddPotential( const GibbsPotential::Ptr& pot ) {
-		
-		if( potentials.count( pot->id ) > 0 ) {
+
+		Topology& t = MutableTopology();
+		if( pot->id != t.potentials.size() ) {
 			std::stringstream ss;
-			ss << "Field already has potential with id " << pot->id;
+			ss << "Field expected potential with id " << t.potentials.size()
+			   << " but received id " << pot->id;
 			throw std::runtime_error( ss.str() );
 		}
-		potentials[ pot->id ] = pot;
+		BOOST_FOREACH( unsigned int varID, pot->GetCliqueIDs() ) {
+			if( varID >= t.variables.size() ) {
+				std::stringstream ss;
+				ss << "Potential " << pot->id << " refers to nonexistent variable " << varID;
+				throw std::runtime_error( ss.str() );
+			}
+		}
+		if( pot->NumStatistics() > GibbsPotential::MaxStatistics ) {
+			std::stringstream ss;
+			ss << "Potential " << pot->id << " keeps " << pot->NumStatistics()
+			   << " statistics but at most " << GibbsPotential::MaxStatistics << " are allowed";
+			throw std::runtime_error( ss.str() );
+		}
+		t.potentials.push_back( pot );
+		t.adjacencyValid = false;
+		t.coloringValid = false;
+
+		t.statisticOffsets.push_back( t.statisticOffsets.back() + pot->NumStatistics() );
+		if( pot->NumStatistics() > 0 ) {
+			statistics.resize( t.statisticOffsets.back() );
+			InitializeStatistics( pot->id );
+		}
+
+		if( trackLogPotential ) {
+			AccumulateTrackedPotential( pot->CalculateLogPotential( *this ), true );
+		}
+	}
+
+	void GibbsField::ReplacePotential( const GibbsPotential::Ptr& pot ) {
+
+		if( pot->id >= topology->potentials.size() ) {
+			std::stringstream ss;
+			ss << "Cannot replace nonexistent potential " << pot->id;
+			throw std::runtime_error( ss.str() );
+		}
+		IDRange oldClique = topology->potentials[ pot->id ]->GetCliqueIDs();
+		IDRange newClique = pot->GetCliqueIDs();
+		if( oldClique.size() != newClique.size() ||
+			!std::equal( oldClique.begin(), oldClique.end(), newClique.begin() ) ) {
+			std::stringstream ss;
+			ss << "Replacement for potential " << pot->id << " has a different clique";
+			throw std::runtime_error( ss.str() );
+		}
+		if( pot->NumStatistics() != topology->potentials[ pot->id ]->NumStatistics() ) {
+			std::stringstream ss;
+			ss << "Replacement for potential " << pot->id << " keeps different statistics";
+			throw std::runtime_error( ss.str() );
+		}
+
+		if( trackLogPotential ) {
+			AccumulateTrackedPotential( topology->potentials[ pot->id ]->CalculateLogPotential( *this ),
+										false );
+		}
+		MutableTopology().potentials[ pot->id ] = pot;
+		if( pot->NumStatistics() > 0 ) {
+			InitializeStatistics( pot->id );
+		}
+		if( trackLogPotential ) {
+			AccumulateTrackedPotential( pot->CalculateLogPotential( *this ), true );
+		}
 	}
 
 	GibbsVariable::Ptr GibbsField::GetVariable( unsigned int id ) const {
-		return variables.at( id );
+		return topology->variables.at( id );
 	}
 
 	GibbsPotential::Ptr GibbsField::GetPotential( unsigned int id ) const {
-		return potentials.at( id );
+		return topology->potentials.at( id );
 	}
-	
+
 	std::vector<GibbsVariable::Ptr> GibbsField::GetVariables() const {
-		std::vector<GibbsVariable::Ptr> vars( variables.size() );
-		unsigned int idx = 0;
-		BOOST_FOREACH( const VariableMap::value_type& item, variables ) {
-// 			vars[idx] = item.second;
-			vars[ item.second->id ] = item.second;
-			idx++;
-		}
-		return vars;
+		return topology->variables;
 	}
 
 	std::vector<GibbsPotential::Ptr> GibbsField::GetPotentials() const {
-		std::vector<GibbsPotential::Ptr> pots( potentials.size() );
-		BOOST_FOREACH( const PotentialMap::value_type& item, potentials) {
-			pots.push_back( item.second );
-		}
-		return pots;
+		return topology->potentials;
 	}
 
 	std::size_t GibbsField::NumVariables() const {
-		return variables.size();
+		return topology->variables.size();
 	}
 
 	std::size_t GibbsField::NumPotentials() const {
-		return potentials.size();
+		return topology->potentials.size();
+	}
+
+	const PackedStateArray& GibbsField::GetStates() const {
+		return states;
 	}
 
-	double GibbsField::CalculateLogPotential() {
+	void GibbsField::SetStates( const PackedStateArray& _states ) {
+		if( _states.size() != states.size() ) {
+			std::stringstream ss;
+			ss << "Field has " << states.size() << " variables but received "
+			   << _states.size() << " states";
+			throw std::runtime_error( ss.str() );
+		}
+		states = _states;
+		if( !statistics.empty() ) {
+			for( unsigned int potID = 0; potID < NumPotentials(); potID++ ) {
+				InitializeStatistics( potID );
+			}
+		}
+		if( trackLogPotential ) {
+			SetLogPotentialTracking( true );
+		}
+	}
+
+	bool GibbsField::SharesTopology( const GibbsField& other ) const {
+		return topology == other.topology;
+	}
+
+	double GibbsField::CalculateLogPotential() const {
 		double sum = 0;
-		BOOST_FOREACH( const PotentialMap::value_type& item, potentials ) {
-			double pot = item.second->CalculatePotential();
-			sum += std::log( pot );
+		BOOST_FOREACH( const GibbsPotential::Ptr& item, topology->potentials ) {
+			sum += item->CalculateLogPotential( *this );
 		}
 		return sum;
 	}
-	
-}
\ No newline at end of file
+
+	void GibbsField::SetLogPotentialTracking( bool enable ) {
+
+		trackLogPotential = enable;
+		finiteLogSum = 0;
+		numZeroPotentials = 0;
+		if( !enable ) {
+			return;
+		}
+
+		BOOST_FOREACH( const GibbsPotential::Ptr& item, topology->potentials ) {
+			AccumulateTrackedPotential( item->CalculateLogPotential( *this ), true );
+		}
+	}
+
+	bool GibbsField::IsTrackingLogPotential() const {
+		return trackLogPotential;
+	}
+
+	double GibbsField::GetLogPotential() const {
+		if( !trackLogPotential ) {
+			throw std::logic_error( "Log-potential tracking is not enabled." );
+		}
+		if( numZeroPotentials > 0 ) {
+			return -std::numeric_limits<double>::infinity();
+		}
+		return finiteLogSum;
+	}
+
+	void GibbsField::UpdateStatistics( unsigned int varID, unsigned char oldState,
+									   unsigned char newState ) {
+
+		RequireAdjacency();
+
+		const Topology& t = *topology;
+		IDRange potIDs = GetVariableAdjacency( varID );
+		IDRange positions = GetVariableAdjacencyPositions( varID );
+		for( unsigned int k = 0; k < potIDs.size(); k++ ) {
+			const unsigned int potID = potIDs[k];
+			if( t.statisticOffsets[potID] != t.statisticOffsets[potID+1] ) {
+				t.potentials[potID]->UpdateStatistics( positions[k], oldState, newState,
+														statistics.data() + t.statisticOffsets[potID] );
+			}
+		}
+	}
+
+	void GibbsField::InitializeStatistics( unsigned int potID ) {
+		const Topology& t = *topology;
+		if( t.statisticOffsets[potID] == t.statisticOffsets[potID+1] ) {
+			return;
+		}
+		const GibbsPotential& pot = *t.potentials[potID];
+		pot.InitializeStatistics( CliqueStates( *this, pot.GetCliqueIDs() ),
+								  statistics.data() + t.statisticOffsets[potID] );
+	}
+
+	void GibbsField::AccumulateTrackedPotentials( unsigned int varID, bool add ) {
+
+		RequireAdjacency();
+		
+		BOOST_FOREACH( unsigned int potID, GetVariableAdjacency( varID ) ) {
+			AccumulateTrackedPotential( GetPotentialRaw( potID )->CalculateLogPotential( *this ), add );
+		}
+	}
+
+	void GibbsField::AccumulateTrackedPotential( double logValue, bool add ) {
+
+		if( logValue == -std::numeric_limits<double>::infinity() ) {
+			if( add ) {
+				numZeroPotentials++;
+			}
+			else {
+				numZeroPotentials--;
+			}
+		}
+		else if( add ) {
+			finiteLogSum += logValue;
+		}
+		else {
+			finiteLogSum -= logValue;
+		}
+	}
+
+	void GibbsField::BuildAdjacency() {
+
+		Topology& t = MutableTopology();
+
+		// The potential to clique table is a concatenation of the clique lists
+		t.potentialCliqueOffsets.assign( 1, 0 );
+		t.potentialCliqueOffsets.reserve( t.potentials.size() + 1 );
+		t.potentialCliqueIndices.clear();
+		BOOST_FOREACH( const GibbsPotential::Ptr& pot, t.potentials ) {
+			IDRange varIDs = pot->GetCliqueIDs();
+			t.potentialCliqueIndices.insert( t.potentialCliqueIndices.end(),
+											 varIDs.begin(), varIDs.end() );
+			t.potentialCliqueOffsets.push_back( t.potentialCliqueIndices.size() );
+		}
+
+		// The variable to potential table is its transpose, built by counting sort
+		// so that each row lists potentials in increasing ID order
+		t.variablePotentialOffsets.assign( t.variables.size() + 1, 0 );
+		BOOST_FOREACH( unsigned int varID, t.potentialCliqueIndices ) {
+			t.variablePotentialOffsets[ varID + 1 ]++;
+		}
+		for( unsigned int i = 0; i < t.variables.size(); i++ ) {
+			t.variablePotentialOffsets[i+1] += t.variablePotentialOffsets[i];
+		}
+
+		t.variablePotentialIndices.resize( t.potentialCliqueIndices.size() );
+		t.variablePotentialPositions.resize( t.potentialCliqueIndices.size() );
+		std::vector<unsigned int> fill( t.variablePotentialOffsets.begin(),
+										t.variablePotentialOffsets.end() - 1 );
+		for( unsigned int potID = 0; potID < t.potentials.size(); potID++ ) {
+			for( unsigned int i = t.potentialCliqueOffsets[potID];
+				 i < t.potentialCliqueOffsets[potID+1]; i++ ) {
+				unsigned int varID = t.potentialCliqueIndices[i];
+				t.variablePotentialPositions[ fill[varID] ] = i - t.potentialCliqueOffsets[potID];
+				t.variablePotentialIndices[ fill[varID]++ ] = potID;
+			}
+		}
+
+		t.adjacencyValid = true;
+	}
+
+	bool GibbsField::HasAdjacency() const {
+		return topology->adjacencyValid;
+	}
+
+	void GibbsField::RequireAdjacency() const {
+		if( !HasAdjacency() ) {
+			throw std::logic_error( "Field adjacency must be rebuilt after adding variables or potentials." );
+		}
+	}
+
+	void GibbsField::BuildColoring() {
+
+		if( !HasAdjacency() ) {
+			BuildAdjacency();
+		}
+
+		Topology& t = MutableTopology();
+		const unsigned int numVariables = t.variables.size();
+		const unsigned int uncolored = std::numeric_limits<unsigned int>::max();
+		t.variableColors.assign( numVariables, uncolored );
+		t.numColors = 0;
+
+		// forbidden[c] == varID + 1 marks color c as taken by a neighbor of varID
+		std::vector<unsigned int> forbidden;
+		for( unsigned int varID = 0; varID < numVariables; varID++ ) {
+			BOOST_FOREACH( unsigned int potID, GetVariableAdjacency( varID ) ) {
+				BOOST_FOREACH( unsigned int neighborID, GetPotentialAdjacency( potID ) ) {
+					unsigned int color = t.variableColors[neighborID];
+					if( color != uncolored ) {
+						forbidden[color] = varID + 1;
+					}
+				}
+			}
+
+			unsigned int color = 0;
+			while( color < t.numColors && forbidden[color] == varID + 1 ) {
+				color++;
+			}
+			t.variableColors[varID] = color;
+			if( color == t.numColors ) {
+				t.numColors++;
+				forbidden.push_back( 0 );
+			}
+		}
+
+		t.coloringValid = true;
+	}
+
+	bool GibbsField::HasColoring() const {
+		return topology->adjacencyValid && topology->coloringValid;
+	}
+
+	unsigned int GibbsField::NumColors() const {
+		assert( HasColoring() );
+		return topology->numColors;
+	}
+
+	bool GibbsField::HasStatistics() const {
+		return !statistics.empty();
+	}
+
+}
@@ -1,5 +1,8 @@
 #include "intelligent/Lattice.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
@@ -8,42 +11,210 @@
 
 namespace intelligent {
 	
-	Lattice::Lattice() {}
+	const unsigned int Lattice::NoNode;
+	const std::size_t Lattice::MaxCellsPerNode;
+	const std::size_t Lattice::MinSparseCells;
+
+	namespace {
+
+		bool IsEmpty( const DiscreteBox3& box ) {
+			return box.minX > box.maxX;
+		}
+
+		std::size_t Extent( int lower, int upper ) {
+			return (std::size_t) ( (long long) upper - (long long) lower + 1 );
+		}
+
+		std::size_t CountCells( const DiscreteBox3& box ) {
+			if( IsEmpty( box ) ) {
+				return 0;
+			}
+			return Extent( box.minX, box.maxX )*Extent( box.minY, box.maxY )*
+				   Extent( box.minZ, box.maxZ );
+		}
+
+		bool InBox( const DiscreteBox3& box, const DiscretePoint3& pos ) {
+			return pos.x >= box.minX && pos.x <= box.maxX &&
+				   pos.y >= box.minY && pos.y <= box.maxY &&
+				   pos.z >= box.minZ && pos.z <= box.maxZ;
+		}
+
+		/*! \brief Extends one axis of the grid to cover [lower, upper], at least
+		 * doubling it in each direction it has to grow. */
+		void GrowAxis( int& gridLower, int& gridUpper, int lower, int upper ) {
+			long long extent = (long long) gridUpper - gridLower + 1;
+			if( lower < gridLower ) {
+				gridLower = (int) std::max<long long>( std::min<long long>( lower, gridLower - extent ),
+													   std::numeric_limits<int>::min() );
+			}
+			if( upper > gridUpper ) {
+				gridUpper = (int) std::min<long long>( std::max<long long>( upper, gridUpper + extent ),
+													   std::numeric_limits<int>::max() );
+			}
+		}
+
+	}
+	
+	Lattice::Lattice() :
+		numNodes( 0 ),
+		dense( true ),
+		nextDenseCheck( 0 ) {}
 
 	void Lattice::AddNode( unsigned int id, const DiscretePoint3& pos ) {
 
-		if( idPositionMap.count( id ) > 0 ) {
+		if( id == NoNode ) {
+			std::stringstream ss;
+			ss << "Lattice node id " << id << " is reserved";
+			throw std::runtime_error( ss.str() );
+		}
+		
+		if( id < positions.size() && LookupNode( positions[id] ) == id ) {
 			std::stringstream ss;
 			ss << "Lattice already has node with id " << id;
 			throw std::runtime_error( ss.str() );
 		}
 
-		if( positionIDMap.count( pos ) > 0 ) {
+		if( LookupNode( pos ) != NoNode ) {
 			std::stringstream ss;
 			ss << "Lattice already has node at position " << pos;
 			throw std::runtime_error( ss.str() );
 		}
-		
-		idPositionMap[ id ] = pos;
-		positionIDMap[ pos ] = id;
 
 		boundingBox.ExpandToInclude( pos );
+		std::size_t limit = std::max( MinSparseCells, MaxCellsPerNode*( numNodes + 1 ) );
+		if( dense && !InBox( gridBox, pos ) ) {
+			if( CountCells( boundingBox ) > limit ) {
+				Relayout( boundingBox, false );
+			}
+			else if( IsEmpty( gridBox ) ) {
+				Relayout( boundingBox, true );
+			}
+			else {
+				DiscreteBox3 box = gridBox;
+				GrowAxis( box.minX, box.maxX, boundingBox.minX, boundingBox.maxX );
+				GrowAxis( box.minY, box.maxY, boundingBox.minY, boundingBox.maxY );
+				GrowAxis( box.minZ, box.maxZ, boundingBox.minZ, boundingBox.maxZ );
+				Relayout( box, true );
+			}
+		}
+		else if( !dense && numNodes + 1 >= nextDenseCheck ) {
+			if( CountCells( boundingBox ) <= limit ) {
+				Relayout( boundingBox, true );
+			}
+			else {
+				nextDenseCheck = 2*( numNodes + 1 );
+			}
+		}
+
+		if( id >= positions.size() ) {
+			positions.resize( id + 1 );
+		}
+		positions[id] = pos;
+		if( dense ) {
+			grid[ GridIndex( pos ) ] = id;
+		}
+		else {
+			positionIDMap[ pos ] = id;
+		}
+		numNodes++;
 		
 	}
 
+	void Lattice::Reserve( const DiscreteBox3& box ) {
+		if( IsEmpty( box ) ) {
+			return;
+		}
+		DiscreteBox3 reserved = gridBox;
+		if( !dense ) {
+			reserved = boundingBox;
+		}
+		if( IsEmpty( reserved ) ) {
+			reserved = box;
+		}
+		reserved.ExpandToInclude( DiscretePoint3( box.minX, box.minY, box.minZ ) );
+		reserved.ExpandToInclude( DiscretePoint3( box.maxX, box.maxY, box.maxZ ) );
+		Relayout( reserved, true );
+	}
+
+	bool Lattice::IsDense() const {
+		return dense;
+	}
+
+	unsigned int Lattice::LookupNode( const DiscretePoint3& pos ) const {
+		if( dense ) {
+			if( !InBox( gridBox, pos ) ) {
+				return NoNode;
+			}
+			return grid[ GridIndex( pos ) ];
+		}
+		PositionIDMap::const_iterator iter = positionIDMap.find( pos );
+		return iter == positionIDMap.end() ? NoNode : iter->second;
+	}
+
+	void Lattice::Relayout( const DiscreteBox3& box, bool makeDense ) {
+
+		std::vector<unsigned int> ids = GetNodeIDs();
+
+		dense = makeDense;
+		if( dense ) {
+			gridBox = box;
+			grid.assign( CountCells( gridBox ), NoNode );
+			positionIDMap = PositionIDMap();
+		}
+		else {
+			gridBox = DiscreteBox3();
+			grid = std::vector<unsigned int>();
+			positionIDMap.reserve( ids.size() );
+			nextDenseCheck = 2*( numNodes + 1 );
+		}
+
+		BOOST_FOREACH( unsigned int id, ids ) {
+			if( dense ) {
+				grid[ GridIndex( positions[id] ) ] = id;
+			}
+			else {
+				positionIDMap[ positions[id] ] = id;
+			}
+		}
+	}
+
+	std::size_t Lattice::GridIndex( const DiscretePoint3& pos ) const {
+		return ( Extent( gridBox.minY, gridBox.maxY )*( pos.x - gridBox.minX ) +
+				 ( pos.y - gridBox.minY ) )*Extent( gridBox.minZ, gridBox.maxZ ) +
+			   ( pos.z - gridBox.minZ );
+	}
+
 	DiscretePoint3 Lattice::GetNodePosition( unsigned int id ) const {
-		return idPositionMap.at( id );
+		if( id >= positions.size() || LookupNode( positions[id] ) != id ) {
+			std::stringstream ss;
+			ss << "Lattice has no node with id " << id;
+			throw std::out_of_range( ss.str() );
+		}
+		return positions[id];
 	}
 
 	unsigned int Lattice::GetNodeID( const DiscretePoint3& pos ) const {
-		return positionIDMap.at( pos );
+		unsigned int id = LookupNode( pos );
+		if( id == NoNode ) {
+			std::stringstream ss;
+			ss << "Lattice has no node at position " << pos;
+			throw std::out_of_range( ss.str() );
+		}
+		return id;
+	}
+
+	bool Lattice::TryGetNodeID( const DiscretePoint3& pos, unsigned int& id ) const {
+		id = LookupNode( pos );
+		return id != NoNode;
 	}
 
 	std::vector<unsigned int> Lattice::GetNodeIDs() const {
 		std::vector<unsigned int> ids;
-		
-		BOOST_FOREACH( const PositionIDMap::value_type& item, positionIDMap ) {
-			ids.push_back( item.second );
+		ids.reserve( numNodes );
+		for( unsigned int id = 0; id < positions.size(); id++ ) {
+			if( LookupNode( positions[id] ) == id ) {
+				ids.push_back( id );
+			}
 		}
 		return ids;
 	}
@@ -52,4 +223,27 @@ namespace intelligent {
 		return boundingBox;
 	}
 
-}
\ No newline at end of file
+	std::vector< std::vector<unsigned int> >
+	Lattice::GetColumns( const std::vector<unsigned int>& ids ) const {
+
+		typedef std::pair<int, unsigned int> HeightID;
+		typedef std::map< std::pair<int, int>, std::vector<HeightID> > ColumnMap;
+		ColumnMap columnMap;
+		BOOST_FOREACH( unsigned int id, ids ) {
+			DiscretePoint3 pos = GetNodePosition( id );
+			columnMap[ std::make_pair( pos.x, pos.y ) ].push_back( HeightID( pos.z, id ) );
+		}
+
+		std::vector< std::vector<unsigned int> > columns;
+		columns.reserve( columnMap.size() );
+		BOOST_FOREACH( ColumnMap::value_type& item, columnMap ) {
+			std::sort( item.second.begin(), item.second.end() );
+			columns.emplace_back();
+			BOOST_FOREACH( const HeightID& node, item.second ) {
+				columns.back().push_back( node.second );
+			}
+		}
+		return columns;
+	}
+
+}
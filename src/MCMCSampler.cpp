@@ -1,56 +1,606 @@
 #include "intelligent/MCMCSampler.h"
 
+#include <boost/foreach.hpp>
+
 #include <cassert>
 #include <iostream>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
 namespace intelligent {
 
+	const unsigned int MCMCSampler::BatchSize;
+
 	MCMCSampler::MCMCSampler() :
-		generator( rd() ),
-		hasIndices( false ) {}
+		generator( std::random_device()() ),
+		hasIndices( false ),
+		sweepType( SWEEP_SYSTEMATIC ),
+		numUpdates( 0 ),
+		residualTolerance( 1E-3 ),
+		refreshRate( 0.05 ),
+		residualField( nullptr ),
+		residualNumPotentials( 0 ),
+		inverseTemperature( 1.0 ),
+		scheduleSweep( 0 ),
+		sweepUpdates( 0 ),
+		sweepChanges( 0 ) {}
 
 	void MCMCSampler::SeedDistribution() {
 
-		generator.seed( rd() );
+		std::random_device rd;
+		generator.SetSeed( rd() );
+	}
+
+	void MCMCSampler::SetSeed( uint64_t seed, uint64_t stream ) {
+		generator.SetSeed( seed, stream );
+	}
+
+	uint64_t MCMCSampler::GetSeed() const {
+		return generator.GetSeed();
+	}
+
+	uint64_t MCMCSampler::GetStream() const {
+		return generator.GetStream();
+	}
+
+	MCMCSampler MCMCSampler::Fork() {
+
+		uint64_t high = generator();
+		uint64_t stream = ( high << 32 ) | generator();
+
+		MCMCSampler fork( *this );
+		fork.generator.SetSeed( generator.GetSeed(), stream );
+		fork.residualField = nullptr;
+		return fork;
 	}
 
 	void MCMCSampler::SetIndexSet( const std::vector<unsigned int>& ind ) {
 		hasIndices = true;
 		indices = ind;
+		residualField = nullptr;
 	}
 		
 	void MCMCSampler::Sample( GibbsField& field, unsigned int numSamples ) {
 
+		// Potentials added since the last build would otherwise be missed
+		if( !field.HasAdjacency() ) {
+			field.BuildAdjacency();
+		}
+		
 		// First pull nodes to initialize random distribution
-		std::vector<GibbsVariable::Ptr> variables = field.GetVariables();
+		std::size_t numVariables = field.NumVariables();
 		
-		assert(variables.size() > 0);
+		assert(numVariables > 0);
 
-		std::uniform_real_distribution<> rid( 0, 1 );
-		
-		if( !hasIndices ) {
-			std::uniform_int_distribution<> uid( 0, variables.size()-1 );
-			for( unsigned int i = 0 ; i < numSamples; i++ ) {
-				
-				int index = uid(generator);
+		// Site positions and uniforms are drawn in bulk, a batch at a time. An
+		// empty index set leaves nothing to sample.
+		std::size_t numSites = hasIndices ? indices.size() : numVariables;
+		if( numSites == 0 ) {
+			return;
+		}
+		bool tempered = IsTempered();
+		for( unsigned int done = 0; done < numSamples; done += BatchSize ) {
+
+			unsigned int batch = std::min( BatchSize, numSamples - done );
+			DrawBatch( batch, numSites );
+			for( unsigned int i = 0 ; i < batch; i++ ) {
+
+				unsigned int index = hasIndices ? indices[ batchSites[i] ] : batchSites[i];
 // 				std::cout << "Sampling index " << index << std::endl;
-				assert(variables[index] != nullptr);
-				variables[ index ]->Sample( rid(generator) );
+				UpdateVariable( field, index, batchUniforms[i], tempered );
+			}
+		}
+
+	}
+
+	void MCMCSampler::DrawBatch( unsigned int numDraws, std::size_t numSites ) {
+
+		// A block of four words gives either a site and a uniform or two uniforms
+		std::size_t numBlocks = numSites > 0 ? numDraws : (numDraws + 1)/2;
+		batchWords.resize( 4*numBlocks );
+		generator.Generate( numBlocks, batchWords.data() );
+
+		batchUniforms.resize( numDraws );
+		if( numSites > 0 ) {
+			// Scaling a 53-bit uniform avoids the rejection loop of an integer
+			// distribution, with a negligible bias for any lattice size
+			batchSites.resize( numDraws );
+			for( unsigned int i = 0; i < numDraws; i++ ) {
+				const PhiloxEngine::result_type* words = &batchWords[4*i];
+				batchSites[i] = (unsigned int) ( PhiloxEngine::ToUniform( words[0], words[1] )*numSites );
+				batchUniforms[i] = PhiloxEngine::ToUniform( words[2], words[3] );
 			}
 		}
 		else {
-			std::uniform_int_distribution<> uid( 0, indices.size()-1 );
-			for( unsigned int i = 0 ; i < numSamples; i++ ) {
-				
-				int index = indices[uid(generator)];
-// 				std::cout << "Sampling index " << index << std::endl;
-				assert(variables[index] != nullptr);
-				variables[ index ]->Sample( rid(generator) );
-				
+			for( unsigned int i = 0; i < numDraws; i++ ) {
+				batchUniforms[i] = PhiloxEngine::ToUniform( batchWords[2*i], batchWords[2*i+1] );
+			}
+		}
+	}
+
+	void MCMCSampler::SetThreadPool( const ThreadPool::Ptr& _pool ) {
+		pool = _pool;
+	}
+
+	void MCMCSampler::SampleChromatic( GibbsField& field, unsigned int numSweeps ) {
+
+		if( field.HasStatistics() ) {
+			throw std::logic_error( "Chromatic sampling requires a field without global statistics." );
+		}
+		if( !field.HasColoring() ) {
+			field.BuildColoring();
+		}
+
+		// Bucket the sampled variables by color, in ID order
+		colorClasses.resize( field.NumColors() );
+		BOOST_FOREACH( std::vector<unsigned int>& members, colorClasses ) {
+			members.clear();
+		}
+		if( !hasIndices ) {
+			for( unsigned int varID = 0; varID < field.NumVariables(); varID++ ) {
+				colorClasses[ field.GetColor( varID ) ].push_back( varID );
+			}
+		}
+		else {
+			BOOST_FOREACH( unsigned int varID, indices ) {
+				colorClasses[ field.GetColor( varID ) ].push_back( varID );
+			}
+			BOOST_FOREACH( std::vector<unsigned int>& members, colorClasses ) {
+				std::sort( members.begin(), members.end() );
+			}
+		}
+
+		const unsigned int numChunks = pool ? pool->NumThreads()*ChunksPerThread : 1;
+		chunkBounds.resize( numChunks + 1 );
+		chunkChanges.resize( numChunks );
+		const bool tempered = IsTempered();
+
+		// Every sweep reserves one generator step per variable, so the draw for a
+		// variable does not depend on which chunk or thread samples it
+		uint64_t sweepStep = generator.GetStep();
+		for( unsigned int sweep = 0; sweep < numSweeps; sweep++ ) {
+			BeginSweep();
+			BOOST_FOREACH( const std::vector<unsigned int>& members, colorClasses ) {
+
+				// Split the class into chunks that never share a packed state word,
+				// so that chunks can also be written concurrently
+				chunkBounds[0] = 0;
+				for( unsigned int k = 1; k < numChunks; k++ ) {
+					std::size_t bound = std::max( chunkBounds[k-1], k*members.size()/numChunks );
+					while( bound > 0 && bound < members.size() &&
+						   members[bound]/PackedStateArray::StatesPerWord ==
+						   members[bound-1]/PackedStateArray::StatesPerWord ) {
+						bound++;
+					}
+					chunkBounds[k] = bound;
+				}
+				chunkBounds[numChunks] = members.size();
+				drawnStates.resize( members.size() );
+
+				// Members of a class are conditionally independent, so drawing them
+				// all from the current field is the same as drawing them in turn
+				const GibbsField& constField = field;
+				ThreadPool::Task drawChunk = [&]( unsigned int k ) {
+					chunkChanges[k] = 0;
+					for( std::size_t i = chunkBounds[k]; i < chunkBounds[k+1]; i++ ) {
+						double rng = generator.UniformAt( sweepStep + members[i] );
+						drawnStates[i] = tempered ? DrawConditional( constField, members[i], rng ) :
+							constField.GetVariableRaw( members[i] )->SampleState( constField, rng );
+						if( drawnStates[i] != constField.GetState( members[i] ) ) {
+							chunkChanges[k]++;
+						}
+					}
+				};
+				ThreadPool::Task writeChunk = [&]( unsigned int k ) {
+					for( std::size_t i = chunkBounds[k]; i < chunkBounds[k+1]; i++ ) {
+						field.SetState( members[i], drawnStates[i] );
+					}
+				};
+
+				if( pool ) {
+					pool->ParallelFor( numChunks, drawChunk );
+				}
+				else {
+					drawChunk( 0 );
+				}
+				sweepUpdates += members.size();
+				for( unsigned int k = 0; k < numChunks; k++ ) {
+					sweepChanges += chunkChanges[k];
+				}
+
+				// The running log-potential is shared, so tracked fields are written serially
+				if( pool && !field.IsTrackingLogPotential() ) {
+					pool->ParallelFor( numChunks, writeChunk );
+				}
+				else {
+					for( unsigned int k = 0; k < numChunks; k++ ) {
+						writeChunk( k );
+					}
+				}
+			}
+			sweepStep += field.NumVariables();
+		}
+		generator.Seek( sweepStep );
+	}
+
+	void MCMCSampler::SetBlocks( const std::vector< std::vector<unsigned int> >& _blocks ) {
+		blocks = _blocks;
+	}
+
+	void MCMCSampler::SampleBlocked( GibbsField& field, unsigned int numSweeps ) {
+
+		if( field.HasStatistics() ) {
+			throw std::logic_error( "Blocked sampling requires a field without global statistics." );
+		}
+		if( !field.HasAdjacency() ) {
+			field.BuildAdjacency();
+		}
+
+		// Analyze each chain and find which chain holds each variable
+		chainSamplers.clear();
+		blockStarts.assign( 1, 0 );
+		std::vector<int> variableBlocks( field.NumVariables(), -1 );
+		for( unsigned int c = 0; c < blocks.size(); c++ ) {
+			BOOST_FOREACH( unsigned int varID, blocks[c] ) {
+				if( variableBlocks[varID] >= 0 ) {
+					std::stringstream ss;
+					ss << "Variable " << varID << " is in blocks " << variableBlocks[varID]
+					   << " and " << c << ".";
+					throw std::logic_error( ss.str() );
+				}
+				variableBlocks[varID] = c;
+			}
+			chainSamplers.push_back( ChainSampler( field, blocks[c] ) );
+			blockStarts.push_back( blockStarts.back() + blocks[c].size() );
+		}
+
+		// Greedily color the chains so that chains sharing a potential differ.
+		// forbidden[color] == c + 1 marks color as taken by a neighbor of chain c.
+		std::vector<unsigned int> blockColors( blocks.size() );
+		std::vector<unsigned int> forbidden;
+		blockClasses.clear();
+		for( unsigned int c = 0; c < blocks.size(); c++ ) {
+			BOOST_FOREACH( unsigned int varID, blocks[c] ) {
+				BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( varID ) ) {
+					BOOST_FOREACH( unsigned int neighborID, field.GetPotentialAdjacency( potID ) ) {
+						int neighborBlock = variableBlocks[neighborID];
+						if( neighborBlock >= 0 && (unsigned int) neighborBlock < c ) {
+							forbidden[ blockColors[neighborBlock] ] = c + 1;
+						}
+					}
+				}
+			}
+
+			unsigned int color = 0;
+			while( color < blockClasses.size() && forbidden[color] == c + 1 ) {
+				color++;
+			}
+			blockColors[c] = color;
+			if( color == blockClasses.size() ) {
+				blockClasses.emplace_back();
+				forbidden.push_back( 0 );
+			}
+			blockClasses[color].push_back( c );
+		}
+
+		const unsigned int numChunks = pool ? pool->NumThreads()*ChunksPerThread : 1;
+		chunkBounds.resize( numChunks + 1 );
+		chunkChanges.resize( numChunks );
+		chunkWorkspaces.resize( numChunks );
+		chunkUniforms.resize( numChunks );
+		drawnStates.resize( blockStarts.back() );
+
+		// Every sweep reserves a generator step per variable and one per chain, so
+		// the draws for a chain do not depend on which chunk or thread takes it
+		const std::size_t numVariables = field.NumVariables();
+		uint64_t sweepStep = generator.GetStep();
+		for( unsigned int sweep = 0; sweep < numSweeps; sweep++ ) {
+			BeginSweep();
+			BOOST_FOREACH( const std::vector<unsigned int>& members, blockClasses ) {
+
+				for( unsigned int k = 0; k <= numChunks; k++ ) {
+					chunkBounds[k] = k*members.size()/numChunks;
+				}
+
+				// Chains of a class are conditionally independent, so drawing them
+				// all from the current field is the same as drawing them in turn
+				const GibbsField& constField = field;
+				ThreadPool::Task drawChunk = [&]( unsigned int k ) {
+					chunkChanges[k] = 0;
+					std::vector<double>& uniforms = chunkUniforms[k];
+					for( std::size_t i = chunkBounds[k]; i < chunkBounds[k+1]; i++ ) {
+						unsigned int c = members[i];
+						const std::vector<unsigned int>& chain = blocks[c];
+						uniforms.resize( chain.size() + 1 );
+						for( unsigned int j = 0; j < chain.size(); j++ ) {
+							uniforms[j] = generator.UniformAt( sweepStep + chain[j] );
+						}
+						uniforms[ chain.size() ] = generator.UniformAt( sweepStep + numVariables + c );
+
+						unsigned char* states = &drawnStates[ blockStarts[c] ];
+						chainSamplers[c].Draw( constField, inverseTemperature, uniforms.data(),
+											   states, chunkWorkspaces[k] );
+						for( unsigned int j = 0; j < chain.size(); j++ ) {
+							if( states[j] != constField.GetState( chain[j] ) ) {
+								chunkChanges[k]++;
+							}
+						}
+					}
+				};
+
+				if( pool ) {
+					pool->ParallelFor( numChunks, drawChunk );
+				}
+				else {
+					drawChunk( 0 );
+				}
+
+				// Chains are not aligned to packed state words, so writes are serial
+				BOOST_FOREACH( unsigned int c, members ) {
+					const std::vector<unsigned int>& chain = blocks[c];
+					for( unsigned int j = 0; j < chain.size(); j++ ) {
+						field.SetState( chain[j], drawnStates[ blockStarts[c] + j ] );
+					}
+					sweepUpdates += chain.size();
+				}
+				for( unsigned int k = 0; k < numChunks; k++ ) {
+					sweepChanges += chunkChanges[k];
+				}
+			}
+			sweepStep += numVariables + blocks.size();
+		}
+		generator.Seek( sweepStep );
+	}
+
+	void MCMCSampler::SetSweepType( SweepType type ) {
+		sweepType = type;
+	}
+
+	MCMCSampler::SweepType MCMCSampler::GetSweepType() const {
+		return sweepType;
+	}
+
+	void MCMCSampler::Sweep( GibbsField& field, unsigned int numSweeps ) {
+
+		if( sweepType == SWEEP_CHROMATIC ) {
+			SampleChromatic( field, numSweeps );
+			numUpdates = 0;
+			BOOST_FOREACH( const std::vector<unsigned int>& members, colorClasses ) {
+				numUpdates += members.size()*numSweeps;
+			}
+			return;
+		}
+		if( sweepType == SWEEP_BLOCKED ) {
+			SampleBlocked( field, numSweeps );
+			numUpdates = blockStarts.back()*numSweeps;
+			return;
+		}
+
+		if( !field.HasAdjacency() ) {
+			field.BuildAdjacency();
+		}
+
+		// IDs are assigned as the lattice is built, so increasing ID order walks
+		// neighboring voxels and their states together
+		if( !hasIndices ) {
+			sweepOrder.resize( field.NumVariables() );
+			for( unsigned int i = 0; i < sweepOrder.size(); i++ ) {
+				sweepOrder[i] = i;
+			}
+		}
+		else {
+			sweepOrder = indices;
+			std::sort( sweepOrder.begin(), sweepOrder.end() );
+		}
+
+		if( sweepType == SWEEP_RESIDUAL ) {
+			SweepResidual( field, numSweeps );
+			return;
+		}
+
+		numUpdates = sweepOrder.size()*numSweeps;
+		for( unsigned int sweep = 0; sweep < numSweeps; sweep++ ) {
+			BeginSweep();
+			bool tempered = IsTempered();
+			if( sweepType == SWEEP_PERMUTED ) {
+				std::shuffle( sweepOrder.begin(), sweepOrder.end(), generator );
 			}
+			for( std::size_t done = 0; done < sweepOrder.size(); done += BatchSize ) {
+
+				unsigned int batch = std::min<std::size_t>( BatchSize, sweepOrder.size() - done );
+				DrawBatch( batch, 0 );
+				for( unsigned int i = 0; i < batch; i++ ) {
+					UpdateVariable( field, sweepOrder[done + i], batchUniforms[i], tempered );
+				}
+			}
+		}
+	}
+
+	void MCMCSampler::SetResidualTolerance( double tolerance ) {
+		if( tolerance < 0 || tolerance > 1 ) {
+			std::stringstream ss;
+			ss << "Residual tolerance " << tolerance << " is not in [0,1].";
+			throw std::logic_error( ss.str() );
 		}
+		residualTolerance = tolerance;
+		residualField = nullptr;
+	}
 
+	void MCMCSampler::SetRefreshRate( double rate ) {
+		if( rate < 0 || rate > 1 ) {
+			std::stringstream ss;
+			ss << "Refresh rate " << rate << " is not in [0,1].";
+			throw std::logic_error( ss.str() );
+		}
+		refreshRate = rate;
 	}
-	
+
+	std::size_t MCMCSampler::GetNumUpdates() const {
+		return numUpdates;
+	}
+
+	void MCMCSampler::SweepResidual( GibbsField& field, unsigned int numSweeps ) {
+
+		// On a field the flags do not describe, every variable starts out dirty,
+		// so the first sweep visits all of them. On the same field, only variables
+		// changed since the last residual sweep disturb their neighbors.
+		const std::size_t numVariables = field.NumVariables();
+		if( residualField != &field || residualStates.size() != numVariables ||
+			residualNumPotentials != field.NumPotentials() ) {
+			residualDirty.assign( numVariables, 1 );
+			residualSettled.assign( numVariables, 0 );
+		}
+		else {
+			const PackedStateArray& states = field.GetStates();
+			for( unsigned int varID = 0; varID < numVariables; varID++ ) {
+				if( states.Get( varID ) != residualStates.Get( varID ) ) {
+					MarkResidualDirty( field, varID );
+				}
+			}
+		}
+		// Flags left by a sweep that throws midway must not be trusted later
+		residualField = nullptr;
+		numUpdates = 0;
+
+		for( unsigned int sweep = 0; sweep < numSweeps; sweep++ ) {
+			BeginSweep();
+			for( std::size_t done = 0; done < sweepOrder.size(); done += BatchSize ) {
+
+				// Each visit gets a refresh draw and a sampling draw
+				unsigned int batch = std::min<std::size_t>( BatchSize, sweepOrder.size() - done );
+				DrawBatch( 2*batch, 0 );
+				for( unsigned int i = 0; i < batch; i++ ) {
+
+					unsigned int varID = sweepOrder[done + i];
+					if( !residualDirty[varID] && residualSettled[varID] &&
+						batchUniforms[2*i] >= refreshRate ) {
+						continue;
+					}
+
+					// Draw from the conditional directly, so that the same evaluation
+					// tells whether it has settled
+					bool settled;
+					unsigned char state = DrawConditional( field, varID, batchUniforms[2*i+1], &settled );
+					residualSettled[varID] = settled;
+					numUpdates++;
+					sweepUpdates++;
+					if( state != field.GetState( varID ) ) {
+						field.SetState( varID, state );
+						sweepChanges++;
+						MarkResidualDirty( field, varID );
+					}
+					residualDirty[varID] = 0;
+				}
+			}
+		}
+
+		residualField = &field;
+		residualNumPotentials = field.NumPotentials();
+		residualStates = field.GetStates();
+	}
+
+	void MCMCSampler::MarkResidualDirty( const GibbsField& field, unsigned int varID ) {
+
+		// Global potentials change with every update and would make every variable
+		// dirty, so their members rely on refreshes
+		residualDirty[varID] = 1;
+		BOOST_FOREACH( unsigned int potID, field.GetVariableAdjacency( varID ) ) {
+			if( field.GetStatistics( potID ) != nullptr ) {
+				continue;
+			}
+			BOOST_FOREACH( unsigned int neighborID, field.GetPotentialAdjacency( potID ) ) {
+				residualDirty[neighborID] = 1;
+			}
+		}
+	}
+
+	void MCMCSampler::SetInverseTemperature( double beta ) {
+		if( !( beta >= 0 ) ) {
+			std::stringstream ss;
+			ss << "Inverse temperature " << beta << " is negative.";
+			throw std::logic_error( ss.str() );
+		}
+		inverseTemperature = beta;
+	}
+
+	double MCMCSampler::GetInverseTemperature() const {
+		return inverseTemperature;
+	}
+
+	void MCMCSampler::SetAnnealingSchedule( const AnnealingSchedule::Ptr& _schedule ) {
+		schedule = _schedule;
+		scheduleSweep = 0;
+	}
+
+	bool MCMCSampler::IsTempered() const {
+		return inverseTemperature != 1.0 || schedule;
+	}
+
+	void MCMCSampler::BeginSweep() {
+		if( schedule ) {
+			double changeRate = sweepUpdates > 0 ? (double) sweepChanges / sweepUpdates : 0;
+			SetInverseTemperature( schedule->GetInverseTemperature( scheduleSweep, inverseTemperature,
+																	changeRate ) );
+			scheduleSweep++;
+		}
+		sweepUpdates = 0;
+		sweepChanges = 0;
+	}
+
+	unsigned char MCMCSampler::DrawConditional( const GibbsField& field, unsigned int varID,
+												double rng, bool* settled ) const {
+
+		const GibbsVariable* variable = field.GetVariableRaw( varID );
+		unsigned int numStates = variable->NumStates();
+		double logConditionals[PackedStateArray::MaxStates];
+		variable->CalculateLogConditionals( field, logConditionals );
+
+		double maxLog = -std::numeric_limits<double>::infinity();
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			maxLog = std::max( maxLog, logConditionals[s] );
+		}
+
+		// Zero potentials stay impossible at any temperature, including beta = 0
+		double weights[PackedStateArray::MaxStates];
+		double z = 0;
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			if( logConditionals[s] == -std::numeric_limits<double>::infinity() ) {
+				weights[s] = 0;
+			}
+			else {
+				weights[s] = std::exp( inverseTemperature*( logConditionals[s] - maxLog ) );
+			}
+			z += weights[s];
+		}
+
+		// The most likely state has weight 1, so its probability is 1/z
+		if( settled != nullptr ) {
+			*settled = z > 0 && 1.0/z >= 1.0 - residualTolerance;
+		}
+		return SampleCategorical( weights, numStates, rng );
+	}
+
+	void MCMCSampler::UpdateVariable( GibbsField& field, unsigned int varID, double rng,
+									  bool tempered ) {
+		sweepUpdates++;
+		if( !tempered ) {
+			unsigned char previous = field.GetState( varID );
+			field.GetVariableRaw( varID )->Sample( field, rng );
+			if( field.GetState( varID ) != previous ) {
+				sweepChanges++;
+			}
+			return;
+		}
+
+		unsigned char state = DrawConditional( field, varID, rng );
+		if( state != field.GetState( varID ) ) {
+			field.SetState( varID, state );
+			sweepChanges++;
+		}
+	}
+
 }
@@ -0,0 +1,128 @@
+#include "intelligent/PackedStateArray.h"
+
+#include <algorithm>
+
+namespace intelligent {
+
+	PackedStateArray::PackedStateArray() :
+		numStates( 0 ) {}
+
+	PackedStateArray::PackedStateArray( std::size_t n, unsigned char fill ) :
+		numStates( 0 ) {
+		resize( n, fill );
+	}
+
+	void PackedStateArray::resize( std::size_t n, unsigned char fill ) {
+
+		std::size_t oldSize = numStates;
+		numStates = n;
+		words.resize( ( n + StatesPerWord - 1 ) / StatesPerWord, 0 );
+
+		if( n < oldSize ) {
+			// Clear the now unused tail so whole-word operations stay valid
+			if( !words.empty() ) {
+				words.back() &= ValidMask( words.size() - 1 );
+			}
+			return;
+		}
+
+		if( fill != 0 ) {
+			for( std::size_t i = oldSize; i < n; i++ ) {
+				Set( i, fill );
+			}
+		}
+	}
+
+	void PackedStateArray::push_back( unsigned char state ) {
+		if( numStates % StatesPerWord == 0 ) {
+			words.push_back( 0 );
+		}
+		numStates++;
+		Set( numStates - 1, state );
+	}
+
+	void PackedStateArray::GetRange( std::size_t first, std::size_t count,
+									 unsigned char* out ) const {
+		ForEach( first, first + count,
+				 [out, first]( std::size_t i, unsigned char s ) { out[ i - first ] = s; } );
+	}
+
+	void PackedStateArray::SetRange( std::size_t first, std::size_t count,
+									 const unsigned char* in ) {
+
+		std::size_t i = first;
+		std::size_t last = first + count;
+
+		// Leading partial word
+		for( ; i < last && i % StatesPerWord != 0; i++ ) {
+			Set( i, in[ i - first ] );
+		}
+
+		// Whole words are assembled in a register and stored once
+		for( ; i + StatesPerWord <= last; i += StatesPerWord ) {
+			Word w = 0;
+			for( unsigned int j = 0; j < StatesPerWord; j++ ) {
+				w |= Word( in[ i - first + j ] & StateMask ) << ( j * BitsPerState );
+			}
+			words[ i / StatesPerWord ] = w;
+		}
+
+		// Trailing partial word
+		for( ; i < last; i++ ) {
+			Set( i, in[ i - first ] );
+		}
+	}
+
+	void PackedStateArray::Fill( unsigned char state ) {
+
+		Word pattern = LowBits * ( state & StateMask );
+		std::fill( words.begin(), words.end(), pattern );
+		if( !words.empty() ) {
+			words.back() &= ValidMask( words.size() - 1 );
+		}
+	}
+
+	std::size_t PackedStateArray::Count( unsigned char state ) const {
+
+		// XOR with the replicated state leaves 00 exactly in the matching slots
+		Word pattern = LowBits * ( state & StateMask );
+		std::size_t count = 0;
+		for( std::size_t wi = 0; wi < words.size(); wi++ ) {
+			Word x = words[wi] ^ pattern;
+			Word matches = ~( x | ( x >> 1 ) ) & LowBits & ValidMask( wi );
+			count += PopCount( matches );
+		}
+		return count;
+	}
+
+	std::size_t PackedStateArray::CountNonZero() const {
+
+		std::size_t count = 0;
+		for( std::size_t wi = 0; wi < words.size(); wi++ ) {
+			Word w = words[wi];
+			count += PopCount( ( w | ( w >> 1 ) ) & LowBits );
+		}
+		return count;
+	}
+
+	std::size_t PackedStateArray::MemoryUsage() const {
+		return words.size() * sizeof( Word );
+	}
+
+	bool PackedStateArray::operator==( const PackedStateArray& other ) const {
+		return numStates == other.numStates && words == other.words;
+	}
+
+	bool PackedStateArray::operator!=( const PackedStateArray& other ) const {
+		return !( *this == other );
+	}
+
+	PackedStateArray::Word PackedStateArray::ValidMask( std::size_t wi ) const {
+		std::size_t remaining = numStates - wi * StatesPerWord;
+		if( remaining >= StatesPerWord ) {
+			return ~Word( 0 );
+		}
+		return ( Word( 1 ) << ( remaining * BitsPerState ) ) - 1;
+	}
+
+}
@@ -0,0 +1,154 @@
+#include "intelligent/ParallelTempering.h"
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace intelligent {
+
+	ParallelTempering::ParallelTempering( MCMCSampler& _sampler,
+										  const std::vector<double>& _inverseTemperatures ) :
+		inverseTemperatures( _inverseTemperatures ),
+		numRounds( 0 ) {
+
+		if( inverseTemperatures.empty() ) {
+			throw std::logic_error( "Parallel tempering requires at least one replica." );
+		}
+		std::sort( inverseTemperatures.begin(), inverseTemperatures.end() );
+
+		// The samplers are forked in ladder order so that every rung draws from its
+		// own stream regardless of the thread it runs on
+		BOOST_FOREACH( double beta, inverseTemperatures ) {
+			MCMCSampler fork = _sampler.Fork();
+			fork.SetAnnealingSchedule( AnnealingSchedule::Ptr() );
+			fork.SetInverseTemperature( beta );
+			samplers.push_back( fork );
+		}
+		MCMCSampler swapFork = _sampler.Fork();
+		swapGenerator.SetSeed( swapFork.GetSeed(), swapFork.GetStream() );
+
+		swapsProposed.assign( inverseTemperatures.size() - 1, 0 );
+		swapsAccepted.assign( inverseTemperatures.size() - 1, 0 );
+	}
+
+	std::vector<double> ParallelTempering::GeometricLadder( double minBeta,
+															unsigned int numReplicas ) {
+		if( !( minBeta > 0 ) || minBeta > 1 ) {
+			std::stringstream ss;
+			ss << "Minimum inverse temperature " << minBeta << " is not in (0,1].";
+			throw std::logic_error( ss.str() );
+		}
+
+		std::vector<double> ladder( numReplicas, 1.0 );
+		for( unsigned int k = 0; k + 1 < numReplicas; k++ ) {
+			ladder[k] = std::pow( minBeta, 1.0 - (double) k/(numReplicas - 1) );
+		}
+		return ladder;
+	}
+
+	void ParallelTempering::SetThreadPool( const ThreadPool::Ptr& _pool ) {
+		pool = _pool;
+	}
+
+	void ParallelTempering::SetBase( const DiscreteAssembly::Ptr& assembly ) {
+
+		// Build the shared tables once so that the replicas do not each copy the
+		// topology to build their own
+		GibbsField& baseField = assembly->GetField();
+		if( !baseField.HasAdjacency() ) {
+			baseField.BuildAdjacency();
+		}
+		if( samplers.front().GetSweepType() == MCMCSampler::SWEEP_CHROMATIC &&
+			!baseField.HasColoring() ) {
+			baseField.BuildColoring();
+		}
+
+		// Swaps are decided from the running log-potentials
+		replicas.clear();
+		for( unsigned int k = 0; k < inverseTemperatures.size(); k++ ) {
+			DiscreteAssembly::Ptr replica = std::make_shared<DiscreteAssembly>( *assembly );
+			replica->GetField().SetLogPotentialTracking( true );
+			replicas.push_back( replica );
+		}
+
+		numRounds = 0;
+		std::fill( swapsProposed.begin(), swapsProposed.end(), 0 );
+		std::fill( swapsAccepted.begin(), swapsAccepted.end(), 0 );
+	}
+
+	void ParallelTempering::Run( unsigned int _numRounds, unsigned int sweepsPerRound ) {
+
+		if( replicas.empty() ) {
+			throw std::logic_error( "Parallel tempering requires a base assembly." );
+		}
+
+		ThreadPool::Task sweepTask = [&]( unsigned int k ) {
+			samplers[k].Sweep( replicas[k]->GetField(), sweepsPerRound );
+		};
+
+		for( unsigned int round = 0; round < _numRounds; round++ ) {
+			if( pool ) {
+				pool->ParallelFor( replicas.size(), sweepTask );
+			}
+			else {
+				for( unsigned int k = 0; k < replicas.size(); k++ ) {
+					sweepTask( k );
+				}
+			}
+
+			// Alternating pairs lets a configuration travel the whole ladder
+			// without any replica taking part in two swaps at once
+			for( unsigned int k = numRounds % 2; k + 1 < replicas.size(); k += 2 ) {
+				ProposeSwap( k );
+			}
+			numRounds++;
+		}
+	}
+
+	void ParallelTempering::ProposeSwap( unsigned int rung ) {
+
+		// Accept with probability min( 1, exp( (b_k - b_k+1)(L_k+1 - L_k) ) ). A
+		// zero-potential replica has a log of -infinity, so it is never swapped
+		// colder, and a swap between two such replicas is undefined and rejected.
+		double logLower = replicas[rung]->GetField().GetLogPotential();
+		double logUpper = replicas[rung+1]->GetField().GetLogPotential();
+		double logAccept = ( inverseTemperatures[rung] - inverseTemperatures[rung+1] )*
+			( logUpper - logLower );
+
+		swapsProposed[rung]++;
+		if( std::log( swapGenerator.Uniform() ) < logAccept ) {
+			std::swap( replicas[rung], replicas[rung+1] );
+			swapsAccepted[rung]++;
+		}
+	}
+
+	unsigned int ParallelTempering::NumReplicas() const {
+		return inverseTemperatures.size();
+	}
+
+	double ParallelTempering::GetInverseTemperature( unsigned int rung ) const {
+		return inverseTemperatures[rung];
+	}
+
+	DiscreteAssembly::Ptr ParallelTempering::GetReplica( unsigned int rung ) const {
+		return replicas[rung];
+	}
+
+	DiscreteAssembly::Ptr ParallelTempering::GetColdReplica() const {
+		return replicas.back();
+	}
+
+	std::vector<double> ParallelTempering::GetSwapRates() const {
+		std::vector<double> rates( swapsProposed.size(), 0 );
+		for( unsigned int k = 0; k < rates.size(); k++ ) {
+			if( swapsProposed[k] > 0 ) {
+				rates[k] = (double) swapsAccepted[k] / swapsProposed[k];
+			}
+		}
+		return rates;
+	}
+
+}
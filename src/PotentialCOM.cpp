@@ -5,15 +5,20 @@
 #include <iostream>
 #include <memory>
 #include <cmath>
+#include <limits>
 
 namespace intelligent {
 	
-	PotentialCOM::PotentialCOM(const GibbsField & _field, unsigned int _id,
+	PotentialCOM::PotentialCOM(unsigned int _id,
 		const std::vector<unsigned int> & _vids, const Lattice & _lattice) 
-	: GibbsPotential(_field, _id, _vids)
-	, lattice(&_lattice) 
+	: GibbsPotential(_id, _vids)
 	{
-		const auto & bbox = lattice->GetBoundingBox(); 
+		positions.reserve(_vids.size());
+		for (size_t i=0; i<_vids.size(); i++) {
+			positions.push_back(_lattice.GetNodePosition(_vids[i]));
+		}
+
+		const auto & bbox = _lattice.GetBoundingBox(); 
 		auto dx = bbox.maxX - bbox.minX + 1;
 		auto dy = bbox.maxY - bbox.minY + 1;
 		auto dz = bbox.maxZ - bbox.minZ + 1;
@@ -25,34 +30,57 @@ namespace intelligent {
 		std::cout << "Constructing COM potential." << std::endl;
 	}  
     
-	// FIXME: Pointer to lattice and desiredCOM
-	// Calling this constructor from anywhere other than Clone() is a bad idea
-	PotentialCOM::PotentialCOM(const GibbsField & _field, 
-		const GibbsPotential & _other) 
-	: GibbsPotential(_field, _other) 
-	{}
-
-	GibbsPotential::Ptr PotentialCOM::Clone(const GibbsField & _field) {
-		return std::make_shared<PotentialCOM>(_field, *this);
-	}
-
 	void PotentialCOM::SetDesiredCOM(const ContinuousPoint3 & _com) {
 		desiredCOM = _com;
 	}
 	
-	double PotentialCOM::CalculatePotential() {
+	double PotentialCOM::Evaluate(const CliqueStates& states) const {
+		double stats[4];
+		InitializeStatistics(states, stats);
+		return EvaluateStatistics(stats);
+	}
 
-		ContinuousPoint3 com = CalculateCOM();
-		
-		auto dx = std::abs(com.x - desiredCOM.x);
-		auto dy = std::abs(com.y - desiredCOM.y);
-		auto dz = std::abs(com.z - desiredCOM.z);
+	double PotentialCOM::EvaluateLog(const CliqueStates& states) const {
+		double stats[4];
+		InitializeStatistics(states, stats);
+		return EvaluateLogStatistics(stats);
+	}
 
-// 		double p = 1;
-// 		if( dx + dy + dz > 4 ) {
-// 			p = 0.01;
-// 		}
-		double deviation = dx + dy + dz;
+	unsigned int PotentialCOM::NumStatistics() const {
+		return 4;
+	}
+
+	void PotentialCOM::InitializeStatistics(const CliqueStates& states, double* stats) const {
+		double cx = 0.0, cy = 0.0, cz = 0.0;
+		double totalMass = 0.0;
+		for (size_t i=0; i<states.size(); i++) {
+			double mass = GetBlockMass(GetBlockState(states, i));
+			const DiscretePoint3& blockPosition = positions[i];
+			totalMass += mass;
+			cx += mass * blockPosition.x;
+			cy += mass * blockPosition.y;
+			cz += mass * blockPosition.z;
+		}
+		stats[0] = totalMass;
+		stats[1] = cx;
+		stats[2] = cy;
+		stats[3] = cz;
+	}
+
+	void PotentialCOM::UpdateStatistics(std::size_t cliqueIndex, unsigned char oldState,
+										unsigned char newState, double* stats) const {
+		double dm = GetBlockMass(static_cast<BlockType>(newState))
+				  - GetBlockMass(static_cast<BlockType>(oldState));
+		const DiscretePoint3& blockPosition = positions[cliqueIndex];
+		stats[0] += dm;
+		stats[1] += dm * blockPosition.x;
+		stats[2] += dm * blockPosition.y;
+		stats[3] += dm * blockPosition.z;
+	}
+
+	double PotentialCOM::EvaluateStatistics(const double* stats) const {
+
+		double deviation = CalculateDeviation(stats);
 		double p = 1.0;
 
 		// HACK Make a parameter or something
@@ -64,39 +92,41 @@ namespace intelligent {
 			p = std::exp( -deviation );
 		}
 
-// 		std::cout << "p: " << p << " for com: " << com.x << ", " << com.y << ", " << com.z << std::endl;
 		return p;
 	}
 
-	ContinuousPoint3 PotentialCOM::CalculateCOM() {
-		const auto & bbox = lattice->GetBoundingBox();
-		std::vector<GibbsVariable::Ptr> clique = GetClique();
-		BlockVariable::Ptr blockVariable;
-		DiscretePoint3 blockPosition;
-		double cx = 0.0, cy = 0.0, cz = 0.0;
-		double totalMass = 0.0;
-		for (size_t i=0; i<clique.size(); i++) {
-			double mass = 0.0;
-			blockVariable = std::dynamic_pointer_cast<BlockVariable>(clique[i]);
-			blockPosition = lattice->GetNodePosition(blockVariable->id);
-			switch (blockVariable->GetState()) {
-				case BLOCK_FULL:  mass = 1.0; break;
-				case BLOCK_HALF:  mass = 0.5; break;
-				case BLOCK_EMPTY: mass = 0.0; break;
-				default: throw std::runtime_error("Invalid block state");
-			}
-			totalMass += mass;
-			cx += mass * blockPosition.x;
-			cy += mass * blockPosition.y;
-			cz += mass * blockPosition.z;
+	double PotentialCOM::EvaluateLogStatistics(const double* stats) const {
+
+		double deviation = CalculateDeviation(stats);
+
+		// Mirrors the cases in EvaluateStatistics()
+		if( deviation > 2.0 ) {
+			return std::log(1E-6);
 		}
-		ContinuousPoint3 com;
-		com.x = cx/totalMass;
-		com.y = cy/totalMass;
-		com.z = cz/totalMass;
-		return com;
+		return -deviation;
 	}
-				
-}
 
+	double PotentialCOM::CalculateDeviation(const double* stats) const {
+
+		// An empty assembly has no COM, so treat it as infinitely far away
+		if( stats[0] <= 0.0 ) {
+			return std::numeric_limits<double>::infinity();
+		}
 
+		ContinuousPoint3 com;
+		com.x = stats[1]/stats[0];
+		com.y = stats[2]/stats[0];
+		com.z = stats[3]/stats[0];
+		
+		auto dx = std::abs(com.x - desiredCOM.x);
+		auto dy = std::abs(com.y - desiredCOM.y);
+		auto dz = std::abs(com.z - desiredCOM.z);
+
+// 		double p = 1;
+// 		if( dx + dy + dz > 4 ) {
+// 			p = 0.01;
+// 		}
+		return dx + dy + dz;
+	}
+
+}
@@ -2,13 +2,14 @@
 #include "intelligent/BlockVariable.h"
 #include <memory>
 #include <iostream>
+#include <limits>
 
 namespace intelligent {
 
-	PotentialEdge::PotentialEdge( const GibbsField& _field, unsigned int _id,
+	PotentialEdge::PotentialEdge( unsigned int _id,
 									const std::vector<unsigned int>& _variableIDs,
 									const Lattice& _lattice ) : 
-									GibbsPotential( _field, _id,_variableIDs ) {
+									GibbsPotential( _id,_variableIDs ) {
 
 		// get node id
 		unsigned int node_id = _variableIDs[0];
@@ -42,30 +43,14 @@ namespace intelligent {
 		
 	}  
   
-	PotentialEdge::PotentialEdge( const GibbsField& _field, const PotentialEdge& other ) :
-		GibbsPotential( _field, other ),
-		edge( other.edge ) {}
-
-	GibbsPotential::Ptr PotentialEdge::Clone( const GibbsField& _field ){
-		std::shared_ptr<GibbsPotential> pointer =
-			std::make_shared<PotentialEdge>( _field, *this );
-		return pointer;
-	}
-			
-	double PotentialEdge::CalculatePotential(){
+	double PotentialEdge::Evaluate( const CliqueStates& states ) const {
 			
-		std::vector < GibbsVariable :: Ptr > clique = GetClique() ;
+		// Only the first (self) variable matters
+		double me = 0;
+		BlockType type = GetBlockState( states, 0 );
+		if ( type == BLOCK_FULL ) { me = 1; }
+		else if ( type == BLOCK_HALF ) { me = .5; }
 
-		std::vector < BlockVariable :: Ptr > markov_blanket( clique.size() );
-		std::vector < double > blanket_val( clique.size() );
-		for(unsigned int i=0; i<clique.size(); i++) { //(int n=10; n>0; n--)
-			markov_blanket[i] = std::dynamic_pointer_cast <BlockVariable>( clique[i] );
-			if ( markov_blanket[i]->GetState() == BLOCK_FULL ) { blanket_val[i] = 1; }
-			else if ( markov_blanket[i]->GetState() == BLOCK_HALF ) { blanket_val[i] = .5; }
-			else { blanket_val[i] = 0; }
-		}
-		
-		double me = blanket_val[0];
 		double prob = 1;
 		if (edge && me != 0) {
 			prob = 0;
@@ -74,7 +59,12 @@ namespace intelligent {
 		
 		return prob;
 	}
-				
-}
 
+	double PotentialEdge::EvaluateLog( const CliqueStates& states ) const {
 
+		if( edge && GetBlockState( states, 0 ) != BLOCK_EMPTY ) {
+			return -std::numeric_limits<double>::infinity();
+		}
+		return 0;
+	}
+}
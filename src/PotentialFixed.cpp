@@ -1,32 +1,33 @@
 #include "intelligent/PotentialFixed.h"
 
+#include <limits>
+
 namespace intelligent {
 
-	PotentialFixed::PotentialFixed( const GibbsField& _field, unsigned int _id,
+	PotentialFixed::PotentialFixed( unsigned int _id,
 									const std::vector<unsigned int>& _variableIDs,
 									BlockType fix ) :
-		GibbsPotential( _field, _id, _variableIDs ),
+		GibbsPotential( _id, _variableIDs ),
 		fixType( fix ) {}
 
-	PotentialFixed::PotentialFixed( const GibbsField& _field, const PotentialFixed& other ) :
-		GibbsPotential( _field, other ),
-		fixType( other.fixType ) {}
+	double PotentialFixed::Evaluate( const CliqueStates& states ) const {
 
-	GibbsPotential::Ptr PotentialFixed::Clone( const GibbsField& _field ) {
-		GibbsPotential::Ptr pointer =
-			std::make_shared<PotentialFixed>( _field, *this );
-		return pointer;
+		if( GetBlockState( states, 0 ) == fixType ) {
+			return 1.0;
+		}
+		return 0.0;
 	}
 
-	double PotentialFixed::CalculatePotential() {
-
-		std::vector<GibbsVariable::Ptr> clique = GetClique();
-		BlockVariable::Ptr block = std::dynamic_pointer_cast<BlockVariable>( clique[0] );
+	double PotentialFixed::EvaluateLog( const CliqueStates& states ) const {
 
-		if( block->GetState() == fixType ) {
-			return 1.0;
+		if( GetBlockState( states, 0 ) == fixType ) {
+			return 0;
 		}
-		return 0.0;
+		return -std::numeric_limits<double>::infinity();
+	}
+
+	bool PotentialFixed::IsEquivalent( const GibbsPotential& other ) const {
+		return static_cast<const PotentialFixed&>( other ).fixType == fixType;
 	}
 	
-}
\ No newline at end of file
+}
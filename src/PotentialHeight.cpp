@@ -1,11 +1,12 @@
 #include "intelligent/PotentialHeight.h"
 #include "intelligent/BlockVariable.h"
 #include <memory>
+#include <cmath>
 
 namespace intelligent {
 
-	PotentialHeight::PotentialHeight( const GibbsField& _field, unsigned int _id,
-									  const std::vector<unsigned int>& _variableIDs, const Lattice& _lattice ) : GibbsPotential( _field, _id,_variableIDs ) {
+	PotentialHeight::PotentialHeight( unsigned int _id,
+									  const std::vector<unsigned int>& _variableIDs, const Lattice& _lattice ) : GibbsPotential( _id,_variableIDs ) {
 										  
 		// get node id
 		unsigned int node_id = _variableIDs[0];
@@ -13,32 +14,17 @@ namespace intelligent {
 		// send node id to lattice to get node height in lattice
 		nodeHeight = _lattice.GetNodePosition( node_id ).z - _lattice.GetBoundingBox().minZ + 1;
 		latticeHeight = _lattice.GetBoundingBox().maxZ - _lattice.GetBoundingBox().minZ + 1;
+		logNodeHeight = std::log( nodeHeight );
 		
 	}  
   
-	PotentialHeight::PotentialHeight( const GibbsField& _field, const PotentialHeight& other ) :
-		GibbsPotential( _field, other ),
-		nodeHeight( other.nodeHeight ),
-		latticeHeight( other.latticeHeight ) {}
-
-	GibbsPotential::Ptr PotentialHeight::Clone( const GibbsField& _field ){
-		std::shared_ptr<GibbsPotential> pointer =
-			std::make_shared<PotentialHeight>( _field, *this );
-		return pointer;
-	}
-			
-	double PotentialHeight::CalculatePotential(){
+	double PotentialHeight::Evaluate( const CliqueStates& states ) const {
 		
-		std::vector < GibbsVariable :: Ptr > clique = GetClique() ;
-
-		std::vector < BlockVariable :: Ptr > markov_blanket( clique.size() );
-		std::vector < double > blanket_val( clique.size() );
-		// for(unsigned int i=0; i<clique.size(); i++) { 
-			markov_blanket[0] = std::dynamic_pointer_cast <BlockVariable>( clique[0] );
-			if ( markov_blanket[0]->GetState() == BLOCK_FULL ) { blanket_val[0] = 1; }
-			else if ( markov_blanket[0]->GetState() == BLOCK_HALF ) { blanket_val[0] = .5; }
-			else { blanket_val[0] = 0; }
-		//}
+		double blanket_val[1];
+		BlockType type = GetBlockState( states, 0 );
+		if ( type == BLOCK_FULL ) { blanket_val[0] = 1; }
+		else if ( type == BLOCK_HALF ) { blanket_val[0] = .5; }
+		else { blanket_val[0] = 0; }
 		
 		// GetClique returned pointers in the order: self, top, bottom, sides.
 		// here, we only look at the value for ourself
@@ -52,7 +38,12 @@ namespace intelligent {
 			
 		return prob;
 	}
-				
-}
 
+	double PotentialHeight::EvaluateLog( const CliqueStates& states ) const {
 
+		if( GetBlockState( states, 0 ) == BLOCK_EMPTY ) {
+			return 0;
+		}
+		return logNodeHeight;
+	}
+}
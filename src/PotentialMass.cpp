@@ -4,52 +4,55 @@
 #include <memory>
 #include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace intelligent {
 
-	PotentialMass::PotentialMass( const GibbsField& _field, unsigned int _id,
+	PotentialMass::PotentialMass( unsigned int _id,
 								  const std::vector<unsigned int>& _variableIDs,
 								  double _massCoeff, double _maxMass ) :
-		GibbsPotential( _field, _id,_variableIDs ),
+		GibbsPotential( _id,_variableIDs ),
 		massCoeff( _massCoeff ),
 		maxMass( _maxMass ) {
 
 		std::cout << "Constructing mass potential." << std::endl;
 	}
   
-	PotentialMass::PotentialMass( const GibbsField& _field, const PotentialMass& other ) :
-		GibbsPotential( _field, other ),
-		massCoeff( other.massCoeff ),
-		maxMass( other.maxMass ) {}
+	double PotentialMass::Evaluate( const CliqueStates& states ) const {
+		double stats[1];
+		InitializeStatistics( states, stats );
+		return EvaluateStatistics( stats );
+	}
 
-	GibbsPotential::Ptr PotentialMass::Clone( const GibbsField& _field ) {
-		std::shared_ptr<GibbsPotential> pointer =
-			std::make_shared<PotentialMass>( _field, *this );
-		return pointer;
+	double PotentialMass::EvaluateLog( const CliqueStates& states ) const {
+		double stats[1];
+		InitializeStatistics( states, stats );
+		return EvaluateLogStatistics( stats );
 	}
-			
-	double PotentialMass::CalculatePotential() {
 
-		// Get summed mass over whole clique (assembly)
-		std::vector <GibbsVariable::Ptr> clique = GetClique();
+	unsigned int PotentialMass::NumStatistics() const {
+		return 1;
+	}
+
+	void PotentialMass::InitializeStatistics( const CliqueStates& states, double* stats ) const {
 
+		// Get summed mass over whole clique (assembly)
 		double totalMass = 0;
-		for(unsigned int i = 0; i < clique.size(); i++) {
+		for(unsigned int i = 0; i < states.size(); i++) {
+			totalMass += GetBlockMass( GetBlockState( states, i ) );
+		}
+		stats[0] = totalMass;
+	}
 
-			BlockType type = std::dynamic_pointer_cast<BlockVariable>( clique[i] )->GetState();
+	void PotentialMass::UpdateStatistics( std::size_t cliqueIndex, unsigned char oldState,
+										  unsigned char newState, double* stats ) const {
+		stats[0] += GetBlockMass( static_cast<BlockType>( newState ) )
+				  - GetBlockMass( static_cast<BlockType>( oldState ) );
+	}
 
-			switch( type ) {
-				case BLOCK_FULL:
-					totalMass += 1.0;
-					break;
-				case BLOCK_HALF:
-					totalMass += 0.5;
-					break;
-				default:
-					break;
-			}
-		}
+	double PotentialMass::EvaluateStatistics( const double* stats ) const {
 
+		double totalMass = stats[0];
 		double p = 1.0;
 		// we want to reward low masses
 		if( totalMass > maxMass ) {
@@ -58,12 +61,16 @@ namespace intelligent {
 		else {
 			p = std::exp( massCoeff*totalMass );
 		}
-
-		std::cout << "p: " << p << " for mass " << totalMass << std::endl;
 		return p;
-		
 	}
-				
-}
 
+	double PotentialMass::EvaluateLogStatistics( const double* stats ) const {
+
+		double totalMass = stats[0];
+		if( totalMass > maxMass ) {
+			return -std::numeric_limits<double>::infinity();
+		}
+		return massCoeff*totalMass;
+	}
 
+}
@@ -5,9 +5,9 @@
 
 namespace intelligent {
 
-	PotentialRepel::PotentialRepel( const GibbsField& _field, unsigned int _id, 
+	PotentialRepel::PotentialRepel( unsigned int _id, 
 									const std::vector<unsigned int>& _variableIDs, 
-								    const Lattice& _lattice, const ContinuousPoint3 _objPos) : GibbsPotential( _field, _id,_variableIDs ) 
+								    const Lattice& _lattice, const ContinuousPoint3 _objPos) : GibbsPotential( _id,_variableIDs ) 
 	{										  
 		// get node id
 		unsigned int node_id = _variableIDs[0];
@@ -22,27 +22,13 @@ namespace intelligent {
 		distance = std::sqrt( disX*disX + disY*disY + disZ*disZ );	
 	}  
   
-	PotentialRepel::PotentialRepel( const GibbsField& _field, const PotentialRepel& other ) : 
-		GibbsPotential( _field, other ),
-		distance( other.distance )  {}
-
-	GibbsPotential::Ptr PotentialRepel::Clone( const GibbsField& _field ){
-		std::shared_ptr<GibbsPotential> pointer( new PotentialRepel( _field, *this ) );
-		return pointer;
-	}
-			
-	double PotentialRepel::CalculatePotential(){
+	double PotentialRepel::Evaluate( const CliqueStates& states ) const {
 		
-		std::vector < GibbsVariable :: Ptr > clique = GetClique() ;
-
-		std::vector < BlockVariable :: Ptr > markov_blanket( clique.size() );
-		std::vector < double > blanket_val( clique.size() );
-		// for(unsigned int i=0; i<clique.size(); i++) { 
-			markov_blanket[0] = std::dynamic_pointer_cast <BlockVariable>( clique[0] );
-			if ( markov_blanket[0]->GetState() == BLOCK_FULL ) { blanket_val[0] = 1; }
-			else if ( markov_blanket[0]->GetState() == BLOCK_HALF ) { blanket_val[0] = .5; }
-			else { blanket_val[0] = 0; }
-		//}
+		double blanket_val[1];
+		BlockType type = GetBlockState( states, 0 );
+		if ( type == BLOCK_FULL ) { blanket_val[0] = 1; }
+		else if ( type == BLOCK_HALF ) { blanket_val[0] = .5; }
+		else { blanket_val[0] = 0; }
 		
 		// GetClique returned pointers in the order: self, top, bottom, sides.
 		// here, we only look at the value for ourself
@@ -61,7 +47,14 @@ namespace intelligent {
 			
 		return prob;
 	}
-				
-}
 
+	double PotentialRepel::EvaluateLog( const CliqueStates& states ) const {
 
+		// The exponent of Evaluate(), without taking the exp
+		double threshold = 4;
+		if( GetBlockState( states, 0 ) != BLOCK_EMPTY && distance < threshold ) {
+			return -3*( threshold - distance );
+		}
+		return 0;
+	}
+}
@@ -8,33 +8,22 @@
 
 namespace intelligent {
 
-	PotentialSupport::PotentialSupport( const GibbsField& _field, unsigned int _id,
-									const std::vector<unsigned int>& _variableIDs ) : 
-									GibbsPotential( _field, _id,_variableIDs ) {
+	PotentialSupport::PotentialSupport( unsigned int _id,
+										const std::vector<unsigned int>& _variableIDs ) : 
+									GibbsPotential( _id,_variableIDs ) {
 										
 	}  
-  
-	PotentialSupport::PotentialSupport( const GibbsField& _field,
-										const PotentialSupport& other ) :
-		GibbsPotential( _field, other ) {}
-
-	GibbsPotential::Ptr PotentialSupport::Clone( const GibbsField& _field ){
-		std::shared_ptr<GibbsPotential> pointer =
-			std::make_shared<PotentialSupport>( _field, *this );
-		return pointer;
-	}
 			
-	double PotentialSupport::CalculatePotential(){
+	double PotentialSupport::Evaluate( const CliqueStates& states ) const {
 		
-		std::vector <GibbsVariable::Ptr> clique = GetClique() ;
+		if( states.size() != 7 ) {
+			throw std::runtime_error( "Support potential requires a clique of 7." );
+		}
 
-		std::vector <BlockVariable::Ptr> markov_blanket( clique.size() );
-		std::vector <double> blanket_val( clique.size() );
-		
-		for( unsigned int i = 0; i < clique.size(); i++ ) {
-			markov_blanket[i] = std::dynamic_pointer_cast <BlockVariable>( clique[i] );
+		double blanket_val[7];
+		for( unsigned int i = 0; i < 7; i++ ) {
 
-			BlockType type = markov_blanket[i]->GetState();
+			BlockType type = GetBlockState( states, i );
 			switch( type ) {
 				case BLOCK_FULL:
 					blanket_val[i] = 1.0;
@@ -109,7 +98,9 @@ namespace intelligent {
 // 		std::cout << "p: " << prob << " for type " << me << " and points " << points << std::endl;
 		return prob;
 	}
-				
-}
 
+	bool PotentialSupport::IsEquivalent( const GibbsPotential& other ) const {
+		return true;
+	}
 
+}
@@ -0,0 +1,200 @@
+#include "intelligent/PotentialTable.h"
+
+#include <boost/foreach.hpp>
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <sstream>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace intelligent {
+
+	PotentialTable::PotentialTable( const GibbsPotential& pot,
+									const std::vector<unsigned int>& radices ) {
+
+		IDRange clique = pot.GetCliqueIDs();
+		if( radices.size() != clique.size() ) {
+			std::stringstream ss;
+			ss << "Potential " << pot.id << " has " << clique.size()
+			   << " variables but received " << radices.size() << " radices";
+			throw std::runtime_error( ss.str() );
+		}
+
+		std::size_t numEntries = CountEntries( radices );
+		if( numEntries == 0 ) {
+			std::stringstream ss;
+			ss << "Potential " << pot.id << " is too large to tabulate";
+			throw std::runtime_error( ss.str() );
+		}
+		ComputeStrides( radices );
+
+		// Count through every joint state like an odometer, first variable fastest
+		std::vector<unsigned char> digits( radices.size(), 0 );
+		CliqueStates view( clique, digits.data() );
+		values.resize( numEntries );
+		logValues.resize( numEntries );
+		for( std::size_t index = 0; index < numEntries; index++ ) {
+			values[index] = pot.Evaluate( view );
+			logValues[index] = pot.EvaluateLog( view );
+
+			for( unsigned int i = 0; i < digits.size(); i++ ) {
+				if( ++digits[i] < radices[i] ) {
+					break;
+				}
+				digits[i] = 0;
+			}
+		}
+	}
+
+	PotentialTable::PotentialTable( const std::vector<unsigned int>& radices,
+									const std::vector<double>& _logValues ) :
+		logValues( _logValues ) {
+
+		if( CountEntries( radices ) != logValues.size() ) {
+			std::stringstream ss;
+			ss << "Received " << logValues.size() << " log values for a table of "
+			   << CountEntries( radices ) << " entries";
+			throw std::runtime_error( ss.str() );
+		}
+		ComputeStrides( radices );
+
+		values.resize( logValues.size() );
+		for( std::size_t index = 0; index < logValues.size(); index++ ) {
+			values[index] = std::exp( logValues[index] );
+		}
+	}
+
+	void PotentialTable::ComputeStrides( const std::vector<unsigned int>& radices ) {
+		strides.resize( radices.size() );
+		std::size_t stride = 1;
+		for( unsigned int i = 0; i < radices.size(); i++ ) {
+			strides[i] = stride;
+			stride *= radices[i];
+		}
+	}
+
+	std::size_t PotentialTable::CountEntries( const std::vector<unsigned int>& radices ) {
+		std::size_t count = 1;
+		BOOST_FOREACH( unsigned int radix, radices ) {
+			if( radix == 0 || count > std::numeric_limits<std::size_t>::max() / radix ) {
+				return 0;
+			}
+			count *= radix;
+		}
+		return count;
+	}
+
+	TabulatedPotential::TabulatedPotential( unsigned int _id,
+											const std::vector<unsigned int>& _variableIDs,
+											const PotentialTable::Ptr& _table ) :
+		GibbsPotential( _id, _variableIDs ),
+		table( _table ) {
+
+		if( table->NumVariables() != _variableIDs.size() ) {
+			std::stringstream ss;
+			ss << "Table has " << table->NumVariables() << " variables but potential "
+			   << _id << " has " << _variableIDs.size();
+			throw std::runtime_error( ss.str() );
+		}
+	}
+
+	double TabulatedPotential::Evaluate( const CliqueStates& states ) const {
+		return table->GetValue( table->ComputeIndex( states ) );
+	}
+
+	double TabulatedPotential::EvaluateLog( const CliqueStates& states ) const {
+		return table->GetLogValue( table->ComputeIndex( states ) );
+	}
+
+	void TabulatedPotential::CalculateCandidatePotentials( const GibbsField& field,
+														   unsigned int varID,
+														   unsigned int numStates,
+														   double* out ) const {
+		std::size_t base, step;
+		ComputeCandidateIndex( field, varID, base, step );
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			out[s] = table->GetValue( base + s*step );
+		}
+	}
+
+	void TabulatedPotential::CalculateCandidateLogPotentials( const GibbsField& field,
+															  unsigned int varID,
+															  unsigned int numStates,
+															  double* out ) const {
+		std::size_t base, step;
+		ComputeCandidateIndex( field, varID, base, step );
+		for( unsigned int s = 0; s < numStates; s++ ) {
+			out[s] = table->GetLogValue( base + s*step );
+		}
+	}
+
+	const PotentialTable::Ptr& TabulatedPotential::GetTable() const {
+		return table;
+	}
+
+	void TabulatedPotential::ComputeCandidateIndex( const GibbsField& field, unsigned int varID,
+													std::size_t& base, std::size_t& step ) const {
+		IDRange clique = GetCliqueIDs();
+		base = 0;
+		step = 0;
+		for( unsigned int i = 0; i < clique.size(); i++ ) {
+			if( clique[i] == varID ) {
+				step += table->GetStride( i );
+			}
+			else {
+				base += field.GetState( clique[i] )*table->GetStride( i );
+			}
+		}
+	}
+
+	unsigned int TabulatePotentials( GibbsField& field, std::size_t maxEntries ) {
+
+		// The last tabulated potential of each type, for sharing its table
+		typedef std::pair<GibbsPotential::Ptr, PotentialTable::Ptr> Prototype;
+		std::unordered_map<std::type_index, Prototype> prototypes;
+
+		unsigned int numReplaced = 0;
+		std::vector<unsigned int> radices;
+		for( unsigned int potID = 0; potID < field.NumPotentials(); potID++ ) {
+
+			// Potentials that keep statistics are evaluated from them, which a table
+			// cannot reproduce
+			GibbsPotential::Ptr pot = field.GetPotential( potID );
+			if( std::dynamic_pointer_cast<TabulatedPotential>( pot ) || pot->NumStatistics() > 0 ) {
+				continue;
+			}
+
+			IDRange clique = pot->GetCliqueIDs();
+			radices.clear();
+			BOOST_FOREACH( unsigned int varID, clique ) {
+				radices.push_back( field.GetVariableRaw( varID )->NumStates() );
+			}
+			std::size_t numEntries = PotentialTable::CountEntries( radices );
+			if( numEntries == 0 || numEntries > maxEntries ) {
+				continue;
+			}
+
+			std::type_index type( typeid( *pot ) );
+			PotentialTable::Ptr table;
+			auto iter = prototypes.find( type );
+			if( iter != prototypes.end() && iter->second.first->IsEquivalent( *pot ) &&
+				iter->second.second->size() == numEntries ) {
+				table = iter->second.second;
+			}
+			else {
+				table = std::make_shared<PotentialTable>( *pot, radices );
+				prototypes[type] = Prototype( pot, table );
+			}
+
+			std::vector<unsigned int> ids( clique.begin(), clique.end() );
+			field.ReplacePotential( std::make_shared<TabulatedPotential>( potID, ids, table ) );
+			numReplaced++;
+		}
+
+		return numReplaced;
+	}
+
+}
@@ -1,26 +1,175 @@
 #include "intelligent/RandomDistributions.h"
 
 #include <sstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 namespace intelligent {
 
+	// Round multipliers and Weyl key increments from Salmon et al., "Parallel
+	// random numbers: as easy as 1, 2, 3"
+	static const uint32_t PhiloxM0 = 0xD2511F53;
+	static const uint32_t PhiloxM1 = 0xCD9E8D57;
+	static const uint32_t PhiloxW0 = 0x9E3779B9;
+	static const uint32_t PhiloxW1 = 0xBB67AE85;
+	static const unsigned int PhiloxRounds = 10;
+
+	PhiloxEngine::PhiloxEngine( uint64_t _seed, uint64_t _stream ) {
+		SetSeed( _seed, _stream );
+	}
+
+	void PhiloxEngine::SetSeed( uint64_t _seed, uint64_t _stream ) {
+		seed = _seed;
+		stream = _stream;
+		Seek( 0 );
+	}
+
+	uint64_t PhiloxEngine::GetSeed() const {
+		return seed;
+	}
+
+	uint64_t PhiloxEngine::GetStream() const {
+		return stream;
+	}
+
+	void PhiloxEngine::Seek( uint64_t _step ) {
+		step = _step;
+		bufferIndex = 4;
+	}
+
+	uint64_t PhiloxEngine::GetStep() const {
+		return step;
+	}
+
+	double PhiloxEngine::Uniform() {
+		result_type high = (*this)();
+		result_type low = (*this)();
+		return ToUniform( high, low );
+	}
+
+	double PhiloxEngine::UniformAt( uint64_t _step ) const {
+		result_type block[4];
+		GenerateBlock( seed, stream, _step, block );
+		return ToUniform( block[0], block[1] );
+	}
+
+	void PhiloxEngine::Generate( std::size_t numBlocks, result_type* out ) {
+
+		// Run groups of blocks in lockstep, one array element per block, so that
+		// each round becomes a few vector instructions over the group
+		static const unsigned int Lanes = 8;
+		const uint32_t s0 = (uint32_t) stream;
+		const uint32_t s1 = (uint32_t) (stream >> 32);
+
+		std::size_t i = 0;
+		for( ; i + Lanes <= numBlocks; i += Lanes ) {
+			uint32_t c0[Lanes], c1[Lanes], c2[Lanes], c3[Lanes];
+			for( unsigned int l = 0; l < Lanes; l++ ) {
+				uint64_t blockStep = step + i + l;
+				c0[l] = (uint32_t) blockStep;
+				c1[l] = (uint32_t) (blockStep >> 32);
+				c2[l] = s0;
+				c3[l] = s1;
+			}
+
+			uint32_t k0 = (uint32_t) seed;
+			uint32_t k1 = (uint32_t) (seed >> 32);
+			for( unsigned int round = 0; round < PhiloxRounds; round++ ) {
+				for( unsigned int l = 0; l < Lanes; l++ ) {
+					uint64_t p0 = (uint64_t) PhiloxM0*c0[l];
+					uint64_t p1 = (uint64_t) PhiloxM1*c2[l];
+					uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1[l] ^ k0;
+					uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3[l] ^ k1;
+					c1[l] = (uint32_t) p1;
+					c3[l] = (uint32_t) p0;
+					c0[l] = n0;
+					c2[l] = n2;
+				}
+				k0 += PhiloxW0;
+				k1 += PhiloxW1;
+			}
+
+			result_type* group = out + 4*i;
+			for( unsigned int l = 0; l < Lanes; l++ ) {
+				group[4*l] = c0[l];
+				group[4*l+1] = c1[l];
+				group[4*l+2] = c2[l];
+				group[4*l+3] = c3[l];
+			}
+		}
+		for( ; i < numBlocks; i++ ) {
+			GenerateBlock( seed, stream, step + i, out + 4*i );
+		}
+		Seek( step + numBlocks );
+	}
+
+	void PhiloxEngine::GenerateBlock( uint64_t _seed, uint64_t _stream, uint64_t _step,
+									  result_type* out ) {
+
+		// The counter is the step in the low words and the stream in the high
+		uint32_t c0 = (uint32_t) _step;
+		uint32_t c1 = (uint32_t) (_step >> 32);
+		uint32_t c2 = (uint32_t) _stream;
+		uint32_t c3 = (uint32_t) (_stream >> 32);
+		uint32_t k0 = (uint32_t) _seed;
+		uint32_t k1 = (uint32_t) (_seed >> 32);
+
+		for( unsigned int round = 0; round < PhiloxRounds; round++ ) {
+			uint64_t p0 = (uint64_t) PhiloxM0*c0;
+			uint64_t p1 = (uint64_t) PhiloxM1*c2;
+			uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+			uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+			c1 = (uint32_t) p1;
+			c3 = (uint32_t) p0;
+			c0 = n0;
+			c2 = n2;
+			k0 += PhiloxW0;
+			k1 += PhiloxW1;
+		}
+
+		out[0] = c0;
+		out[1] = c1;
+		out[2] = c2;
+		out[3] = c3;
+	}
+
+
 	unsigned int SampleNumberLine( const std::vector<double>& line, double rng ) {
+		return SampleCategorical( line.data(), line.size(), rng );
+	}
 
-		std::vector<double> acc( line.size() );
+	unsigned int SampleLogNumberLine( const std::vector<double>& logLine, double rng ) {
+
+		double maxLog = -std::numeric_limits<double>::infinity();
+		for( unsigned int i = 0; i < logLine.size(); i++ ) {
+			maxLog = std::max( maxLog, logLine[i] );
+		}
+		if( maxLog == -std::numeric_limits<double>::infinity() ) {
+			return 0;
+		}
+
+		// Shift by the largest log so that the largest weight is exactly 1, and
+		// recompute the weights on the second pass rather than storing them
 		double z = 0;
-		for( unsigned int i = 0; i < line.size(); i++ ) {
-			z += line[i];
-			acc[i] = z;
+		for( unsigned int i = 0; i < logLine.size(); i++ ) {
+			z += std::exp( logLine[i] - maxLog );
 		}
 
-		rng = rng*z; // Scale up to max value
-		for( unsigned int i = 0; i < acc.size(); i++ ) {
-			if( rng <= acc[i] ) {
-				return i;
+		double target = rng*z;
+		double acc = 0;
+		unsigned int last = 0;
+		for( unsigned int i = 0; i < logLine.size(); i++ ) {
+			double weight = std::exp( logLine[i] - maxLog );
+			if( weight > 0 ) {
+				acc += weight;
+				last = i;
+				if( target < acc ) {
+					return i;
+				}
 			}
 		}
-		return acc.size() - 1;
-		
+		return last;
 	}
 	
 	UniformDistribution::UniformDistribution( double lower, double upper ) {
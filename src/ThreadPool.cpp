@@ -0,0 +1,154 @@
+#include "intelligent/ThreadPool.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+
+namespace intelligent {
+
+	ThreadPool::ThreadPool( unsigned int numThreads ) :
+		currentTask( nullptr ),
+		numTasks( 0 ),
+		nextTask( 0 ),
+		numActive( 0 ),
+		generation( 0 ),
+		stopping( false ) {
+
+		if( numThreads == 0 ) {
+			numThreads = std::max( boost::thread::hardware_concurrency(), 1u );
+		}
+
+		for( unsigned int i = 1; i < numThreads; i++ ) {
+			boost::thread* worker =
+				workers.create_thread( boost::bind( &ThreadPool::WorkerLoop, this ) );
+			workerIDs.push_back( worker->get_id() );
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			boost::unique_lock<boost::mutex> lock( mutex );
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		workers.join_all();
+	}
+
+	unsigned int ThreadPool::NumThreads() const {
+		return workerIDs.size() + 1;
+	}
+
+	void ThreadPool::ParallelFor( unsigned int _numTasks, const Task& task ) {
+
+		if( _numTasks == 0 ) {
+			return;
+		}
+		if( workerIDs.empty() || InTask() ) {
+			for( unsigned int i = 0; i < _numTasks; i++ ) {
+				task( i );
+			}
+			return;
+		}
+
+		boost::unique_lock<boost::mutex> callLock( callMutex );
+		{
+			boost::unique_lock<boost::mutex> lock( mutex );
+			currentTask = &task;
+			numTasks = _numTasks;
+			nextTask = 0;
+			error = std::exception_ptr();
+			runnerID = boost::this_thread::get_id();
+			generation++;
+			numActive++;
+		}
+		wakeCondition.notify_all();
+
+		RunTasks();
+
+		std::exception_ptr thrown;
+		{
+			boost::unique_lock<boost::mutex> lock( mutex );
+			numActive--;
+			while( numActive > 0 ) {
+				doneCondition.wait( lock );
+			}
+			currentTask = nullptr;
+			runnerID = boost::thread::id();
+			thrown = error;
+		}
+
+		if( thrown ) {
+			std::rethrow_exception( thrown );
+		}
+	}
+
+	void ThreadPool::WorkerLoop() {
+
+		unsigned long seen = 0;
+		while( true ) {
+			{
+				boost::unique_lock<boost::mutex> lock( mutex );
+				while( !stopping && generation == seen ) {
+					wakeCondition.wait( lock );
+				}
+				if( stopping ) {
+					return;
+				}
+				seen = generation;
+				numActive++;
+			}
+
+			RunTasks();
+
+			{
+				boost::unique_lock<boost::mutex> lock( mutex );
+				numActive--;
+				if( numActive == 0 ) {
+					doneCondition.notify_all();
+				}
+			}
+		}
+	}
+
+	void ThreadPool::RunTasks() {
+
+		while( true ) {
+			unsigned int index;
+			const Task* task;
+			{
+				boost::unique_lock<boost::mutex> lock( mutex );
+				if( nextTask >= numTasks ) {
+					return;
+				}
+				index = nextTask++;
+				task = currentTask;
+			}
+
+			try {
+				(*task)( index );
+			}
+			catch( ... ) {
+				boost::unique_lock<boost::mutex> lock( mutex );
+				if( !error ) {
+					error = std::current_exception();
+				}
+				nextTask = numTasks;
+			}
+		}
+	}
+
+	bool ThreadPool::InTask() {
+
+		boost::thread::id self = boost::this_thread::get_id();
+		BOOST_FOREACH( const boost::thread::id& id, workerIDs ) {
+			if( id == self ) {
+				return true;
+			}
+		}
+
+		boost::unique_lock<boost::mutex> lock( mutex );
+		return currentTask != nullptr && runnerID == self;
+	}
+
+}
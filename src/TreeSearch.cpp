@@ -29,6 +29,10 @@ namespace intelligent {
 	void TreeSearch::SetMaxQueueSize( unsigned int q ) {
 		maxQueueSize = q;
 	}
+
+	void TreeSearch::SetSeed( uint64_t seed ) {
+		sampler.SetSeed( seed );
+	}
 	
 	void TreeSearch::Add(DiscreteAssembly::Ptr _da) {
 
@@ -89,14 +93,9 @@ namespace intelligent {
 		properties.totalWavefront = ComputeWavefront( da );
 		
 		const auto & lattice = da.GetLattice();
-		const std::vector<unsigned> & nodeIds = lattice.GetNodeIDs();
+		const auto & states = da.GetField().GetStates();
 		const auto & bbox = lattice.GetBoundingBox();
 		
-		std::vector<GibbsVariable::Ptr> vars;
-		for (const auto & nid : nodeIds) {
-			vars.push_back( da.GetField().GetVariable(nid) );
-		}
-		
 		double wx = bbox.maxX - bbox.minX;
 		double wy = bbox.maxY - bbox.minY;
 		double wz = bbox.maxZ - bbox.minZ;
@@ -106,20 +105,18 @@ namespace intelligent {
 		properties.desiredCOM.y = bbox.minY + wy/2;
 		properties.desiredCOM.z = bbox.minZ + 1;
 
-		BlockVariable::Ptr blockVariable;
-		DiscretePoint3 blockPosition;
 		double cx = 0.0, cy = 0.0, cz = 0.0;
 		properties.totalMass = 0.0;
-		properties.totalBlocks = 0;
+		properties.totalBlocks = states.CountNonZero();
 		properties.zFill = 0;
-		for (const auto & v : vars) {
+
+		// Empty blocks contribute nothing, so only visit the occupied ones
+		states.ForEachNonZero( [&]( std::size_t nid, unsigned char state ) {
 			double mass = 0.0;
-			blockVariable = std::dynamic_pointer_cast<BlockVariable>(v);
-			blockPosition = lattice.GetNodePosition(blockVariable->id);
-			switch (blockVariable->GetState()) {
+			DiscretePoint3 blockPosition = lattice.GetNodePosition(nid);
+			switch (state) {
 				case BLOCK_FULL:  mass = 1.0; break;
 				case BLOCK_HALF:  mass = 0.1; break;
-				case BLOCK_EMPTY: mass = 0.0; break;
 				default: throw std::runtime_error("Invalid block state");
 			}
 			
@@ -128,12 +125,9 @@ namespace intelligent {
 			cy += mass * blockPosition.y;
 			cz += mass * blockPosition.z;
 
-			if( mass != 0 ) {
-				properties.totalBlocks++;
-				double height = blockPosition.z - bbox.minZ + 1;
-				properties.zFill += height*height;
-			}
-		}
+			double height = blockPosition.z - bbox.minZ + 1;
+			properties.zFill += height*height;
+		} );
 
 		double cDenom = properties.totalMass;
 		if( cDenom == 0 ) {
@@ -176,22 +170,19 @@ namespace intelligent {
 		Mat3D<char> connRef( xDim, yDim, zDim );
 		DiscretePoint3 offset( bounds.minX, bounds.minY, bounds.minZ );
 
-		const std::vector<unsigned int>& nodeIds = da.GetLattice().GetNodeIDs();
-		BOOST_FOREACH( unsigned int id, nodeIds ) {
-
-			GibbsVariable::Ptr gibbsVariable = da.GetField().GetVariable( id );
-			BlockVariable::Ptr blockVariable = std::dynamic_pointer_cast<BlockVariable>( gibbsVariable );
+		const Lattice& lattice = da.GetLattice();
+		connRef.Zero();
+		da.GetField().GetStates().ForEachNonZero( [&]( std::size_t id, unsigned char state ) {
 
 			char val = 0;
-			switch( blockVariable->GetState() ) {
+			switch( state ) {
 				case BLOCK_FULL: val = 2; break;
 				case BLOCK_HALF: val = 1; break;
-				case BLOCK_EMPTY: val = 0; break;
 			}
 
-			DiscretePoint3 ind = da.GetLattice().GetNodePosition( id ) - offset;
+			DiscretePoint3 ind = lattice.GetNodePosition( id ) - offset;
 			connRef.At( ind.x, ind.y, ind.z ) = val;
-		}
+		} );
 
 		// 0 means empty, 1 means half, 2 means full, 3 means grounded
 
@@ -286,22 +277,13 @@ namespace intelligent {
 		Mat3D<int> connRef( xDim, yDim, zDim );
 		DiscretePoint3 offset( bounds.minX, bounds.minY, bounds.minZ );
 		
-		const std::vector<unsigned int>& nodeIds = da.GetLattice().GetNodeIDs();
-		BOOST_FOREACH( unsigned int id, nodeIds ) {
-			
-			GibbsVariable::Ptr gibbsVariable = da.GetField().GetVariable( id );
-			BlockVariable::Ptr blockVariable = std::dynamic_pointer_cast<BlockVariable>( gibbsVariable );
-			
-			int val = 0;
-			switch( blockVariable->GetState() ) {
-				case BLOCK_FULL: val = std::numeric_limits<int>::max() - 1; break;
-				case BLOCK_HALF: val = std::numeric_limits<int>::max() - 1; break;
-				case BLOCK_EMPTY: val = -1; break;
-			}
-			
-			DiscretePoint3 ind = da.GetLattice().GetNodePosition( id ) - offset;
-			connRef.At( ind.x, ind.y, ind.z ) = val;
-		}
+		// Every non-empty block starts out at "infinite" distance
+		const Lattice& lattice = da.GetLattice();
+		connRef.Fill( -1 );
+		da.GetField().GetStates().ForEachNonZero( [&]( std::size_t id, unsigned char state ) {
+			DiscretePoint3 ind = lattice.GetNodePosition( id ) - offset;
+			connRef.At( ind.x, ind.y, ind.z ) = std::numeric_limits<int>::max() - 1;
+		} );
 		
 		// -1 means empty, 0 and over is # steps to ground level
 		